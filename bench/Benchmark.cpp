@@ -0,0 +1,471 @@
+#include "Interpreter.hpp"
+#include "Keyboard.hpp"
+#include "Random.hpp"
+#include "SafeQueue.hpp"
+#include "Screen.hpp"
+#include "Timer.hpp"
+#include "UI.hpp"
+#include "Wall.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef CHIP8_EXAMPLE_PROGRAMS_DIR
+#define CHIP8_EXAMPLE_PROGRAMS_DIR "ExamplePrograms"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief keep `value` alive so the work producing it is not optimized out
+ */
+template <typename T> void DoNotOptimize(const T &value) {
+  // NOLINTNEXTLINE(hicpp-no-assembler)
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchmarkResult {
+  std::string name;
+  std::size_t operations;
+  /** nanoseconds per operation, one entry per measured repetition */
+  std::vector<double> samples;
+};
+
+/**
+ * @brief runs each benchmark body for a number of warmup repetitions, then
+ * times every measured repetition separately
+ */
+class Harness {
+public:
+  Harness(std::size_t warmup, std::size_t repetitions, std::string filter)
+      : _warmup(warmup), _repetitions(repetitions), _filter(std::move(filter)) {
+  }
+
+  /**
+   * @param operations how many operations a single call of `body` performs
+   */
+  template <typename Body>
+  void Run(const std::string &name, std::size_t operations, Body &&body) {
+    if (!_filter.empty() && name.find(_filter) == std::string::npos) {
+      return;
+    }
+    for (std::size_t i = 0; i < _warmup; ++i) {
+      body();
+    }
+    BenchmarkResult result{name, operations, {}};
+    result.samples.reserve(_repetitions);
+    for (std::size_t i = 0; i < _repetitions; ++i) {
+      const auto start = Clock::now();
+      body();
+      const auto elapsed = Clock::now() - start;
+      result.samples.push_back(
+        std::chrono::duration<double, std::nano>(elapsed).count() /
+        static_cast<double>(operations));
+    }
+    std::cerr << name << '\n';
+    _results.push_back(std::move(result));
+  }
+
+  void WriteJson(std::ostream &out) const {
+    out << "{\"warmup\":" << _warmup << ",\"repetitions\":" << _repetitions
+        << ",\"benchmarks\":[";
+    bool first = true;
+    for (const auto &result : _results) {
+      auto sorted = result.samples;
+      std::sort(sorted.begin(), sorted.end());
+      const auto mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) /
+                        static_cast<double>(sorted.size());
+      const auto median = Percentile(sorted, 0.5);
+      out << (first ? "" : ",") << "\n  {\"name\":\"" << result.name
+          << "\",\"operations\":" << result.operations
+          << ",\"min_ns\":" << sorted.front() << ",\"mean_ns\":" << mean
+          << ",\"median_ns\":" << median
+          << ",\"p99_ns\":" << Percentile(sorted, 0.99)
+          << ",\"max_ns\":" << sorted.back()
+          << ",\"ops_per_second\":" << 1e9 / median << '}';
+      first = false;
+    }
+    out << "\n]}\n";
+  }
+
+private:
+  // nearest-rank percentile of sorted samples
+  static double Percentile(const std::vector<double> &sorted, double rank) {
+    const auto position = static_cast<std::size_t>(
+      std::ceil(rank * static_cast<double>(sorted.size())));
+    return sorted.at(std::clamp<std::size_t>(position, 1, sorted.size()) - 1);
+  }
+
+  std::size_t _warmup;
+  std::size_t _repetitions;
+  std::string _filter;
+  std::vector<BenchmarkResult> _results;
+};
+
+constexpr std::uint16_t PROGRAM_START = 0x200;
+
+/**
+ * @brief `prefix`, then `count` copies of `body`, then a jump back to the
+ * first copy of `body`
+ */
+std::vector<std::uint8_t> MakeProgram(const std::vector<std::uint16_t> &prefix,
+                                      const std::vector<std::uint16_t> &body,
+                                      std::size_t count) {
+  constexpr static std::uint16_t JUMP = 0x1000;
+  std::vector<std::uint16_t> instructions = prefix;
+  for (std::size_t i = 0; i < count; ++i) {
+    instructions.insert(instructions.end(), body.begin(), body.end());
+  }
+  const auto loopStart = PROGRAM_START + prefix.size() * 2;
+  instructions.push_back(static_cast<std::uint16_t>(JUMP | loopStart));
+  std::vector<std::uint8_t> program;
+  for (const auto instruction : instructions) {
+    program.push_back(static_cast<std::uint8_t>(instruction >> 8));
+    program.push_back(static_cast<std::uint8_t>(instruction & 0xFF));
+  }
+  return program;
+}
+
+void BenchmarkDispatch(Harness &harness) {
+  struct Family {
+    std::string name;
+    std::vector<std::uint16_t> prefix;
+    std::vector<std::uint16_t> body;
+  };
+  constexpr static std::size_t COPIES = 64;
+  constexpr static std::size_t OPERATIONS = 100000;
+  // I points past the program so FX33/FX55 don't overwrite it
+  const std::vector<Family> families{
+    {"00E0", {}, {0x00E0}},
+    {"1NNN", {}, {}},
+    {"2NNN+00EE", {0x1206, 0x00EE, 0x00EE}, {0x2202, 0x2204}},
+    {"3XKK", {}, {0x3001}},
+    {"4XKK", {}, {0x4000}},
+    {"5XY0", {}, {0x5010}},
+    {"6XKK", {}, {0x6A42}},
+    {"7XKK", {}, {0x7A01}},
+    {"8XY0", {}, {0x8120}},
+    {"8XY4", {}, {0x8124}},
+    {"8XY5", {}, {0x8125}},
+    {"8XY6", {}, {0x8126}},
+    {"8XYE", {}, {0x812E}},
+    {"ANNN", {}, {0xA300}},
+    {"BNNN", {}, {}},
+    {"CXKK", {}, {0xC0FF}},
+    {"DXYN", {0xA050}, {0xD125}},
+    {"EX9E", {}, {0xE09E}},
+    {"FX07", {}, {0xF007}},
+    {"FX1E", {}, {0xF01E}},
+    {"FX29", {}, {0xF029}},
+    {"FX33", {0xAE00}, {0xF033}},
+    {"FX55", {0xAE00}, {0xFF55}},
+    {"FX65", {0xAE00}, {0xFF65}},
+  };
+  Keyboard keyboard;
+  Screen screen;
+  Chip8 chip{&keyboard, &screen};
+  for (const auto &family : families) {
+    auto program = MakeProgram(family.prefix, family.body, COPIES);
+    if (family.name == "1NNN") {
+      program = MakeProgram({}, {}, 0);
+    } else if (family.name == "BNNN") {
+      program = {0xB2, 0x00};
+    }
+    chip.Reset();
+    chip.LoadProgram(program);
+    harness.Run("dispatch/" + family.name, OPERATIONS,
+                [&chip]() { chip.Step(OPERATIONS); });
+  }
+}
+
+void BenchmarkDraw(Harness &harness) {
+  constexpr static std::size_t OPERATIONS = 10000;
+  constexpr static std::size_t MAX_SPRITE_ROWS = 15;
+  std::array<std::uint8_t, MAX_SPRITE_ROWS> sprite{};
+  sprite.fill(0xFF);
+  Screen screen;
+  for (const std::size_t rows : {1, 5, 8, 15}) {
+    harness.Run("draw/rows=" + std::to_string(rows), OPERATIONS,
+                [&screen, &sprite, rows]() {
+                  for (std::size_t i = 0; i < OPERATIONS; ++i) {
+                    DoNotOptimize(
+                      screen.Draw(8, 8, std::span(sprite).first(rows)));
+                  }
+                });
+  }
+  // the sprite starts 4 pixels from the right and bottom edges
+  harness.Run("draw/clipped", OPERATIONS, [&screen, &sprite]() {
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      DoNotOptimize(screen.Draw(Screen::WIDTH - 4, Screen::HEIGHT - 4, sprite));
+    }
+  });
+  // every other draw erases the previous one, so half the draws collide
+  harness.Run("draw/collision", OPERATIONS, [&screen, &sprite]() {
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      DoNotOptimize(screen.Draw(0, 0, std::span(sprite).first(8)));
+      DoNotOptimize(screen.Draw(4, 4, std::span(sprite).first(8)));
+    }
+  });
+  harness.Run("draw/large", OPERATIONS, [&screen]() {
+    std::array<std::uint8_t, 32> large{};
+    large.fill(0xFF);
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      DoNotOptimize(screen.DrawLarge(static_cast<Byte>(i % 128), 8, large));
+    }
+  });
+  // an XO-CHIP 8x8 sprite in all four planes
+  screen.SelectPlanes(0xF);
+  harness.Run("draw/planes=4", OPERATIONS, [&screen]() {
+    std::array<std::uint8_t, 8 * Screen::NUM_PLANES> sprite{};
+    sprite.fill(0xFF);
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      DoNotOptimize(screen.Draw(8, 8, sprite));
+    }
+  });
+  screen.SelectPlanes(1);
+  // scrolling games scroll the whole high resolution screen every frame
+  screen.SetHighResolution(true);
+  harness.Run("screen/scroll-down", OPERATIONS, [&screen, &sprite]() {
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      DoNotOptimize(screen.Draw(0, 0, sprite));
+      screen.ScrollDown(1);
+    }
+  });
+  harness.Run("screen/scroll-right", OPERATIONS, [&screen]() {
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      screen.ScrollRight();
+    }
+  });
+  screen.SetHighResolution(false);
+  harness.Run("screen/clear", OPERATIONS, [&screen]() {
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      screen.Clear();
+    }
+  });
+}
+
+void BenchmarkTimers(Harness &harness) {
+  constexpr static std::size_t OPERATIONS = 100000;
+  for (const std::size_t count : {1, 4, 16, 64}) {
+    TimerManager manager;
+    for (std::size_t i = 0; i < count; ++i) {
+      manager.AddTimer(std::chrono::milliseconds{1}, true)
+        .lock()
+        ->RegisterCallback([](unsigned ticks) { DoNotOptimize(ticks); });
+    }
+    harness.Run("timers/tick/n=" + std::to_string(count), OPERATIONS,
+                [&manager]() {
+                  for (std::size_t i = 0; i < OPERATIONS; ++i) {
+                    manager.Tick();
+                  }
+                });
+  }
+}
+
+void BenchmarkRandom(Harness &harness) {
+  constexpr static std::size_t OPERATIONS = 1000000;
+  RandomNumberGenerator random{0, 0};
+  harness.Run("random/generate", OPERATIONS, [&random]() {
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      DoNotOptimize(random.Generate());
+    }
+  });
+  // one draw for each of a batch of environments
+  constexpr static std::size_t LANES = 256;
+  std::vector<std::uint64_t> keys(LANES);
+  std::vector<std::uint64_t> counters(LANES);
+  std::vector<std::uint32_t> out(LANES);
+  for (std::size_t lane = 0; lane < LANES; ++lane) {
+    keys[lane] = RandomNumberGenerator{0, lane}.Key();
+  }
+  harness.Run("random/generate-batch/lanes=256", OPERATIONS,
+              [&keys, &counters, &out]() {
+                for (std::size_t i = 0; i < OPERATIONS / LANES; ++i) {
+                  RandomNumberGenerator::GenerateBatch(keys, counters, out);
+                  for (auto &counter : counters) {
+                    ++counter;
+                  }
+                  DoNotOptimize(out.front());
+                }
+              });
+}
+
+void BenchmarkQueue(Harness &harness) {
+  constexpr static std::size_t OPERATIONS = 200000;
+  for (const std::size_t producers : {1, 2, 4}) {
+    harness.Run(
+      "safe-queue/producers=" + std::to_string(producers), OPERATIONS,
+      [producers]() {
+        SafeQueue<std::size_t> queue;
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < producers; ++p) {
+          threads.emplace_back([&queue, producers]() {
+            for (std::size_t i = 0; i < OPERATIONS / producers; ++i) {
+              queue.Enqueue(std::size_t{i});
+            }
+          });
+        }
+        std::size_t consumed = 0;
+        while (consumed < (OPERATIONS / producers) * producers) {
+          if (queue.TryDequeue().has_value()) {
+            ++consumed;
+          }
+        }
+        for (auto &thread : threads) {
+          thread.join();
+        }
+      });
+  }
+}
+
+void BenchmarkFrameConversion(Harness &harness) {
+  constexpr static std::size_t OPERATIONS = 10000;
+  SdlManager::Frame frame;
+  for (auto &row : frame.planes.front()) {
+    row = {0x4924924924924924, 0x9249249249249249};
+  }
+  std::vector<Uint32> pixels(Screen::HIRES_WIDTH * Screen::HIRES_HEIGHT);
+  harness.Run("render/convert-frame", OPERATIONS, [&frame, &pixels]() {
+    for (std::size_t i = 0; i < OPERATIONS; ++i) {
+      SdlManager::ConvertFrame(frame, pixels);
+      DoNotOptimize(pixels.front());
+    }
+  });
+  // a wall of 256 tiles converts up to 256 of these per present
+  std::vector<Uint32> tile(WallManager::TILE_WIDTH * WallManager::TILE_HEIGHT);
+  std::array<std::uint8_t, 15> sprite{};
+  sprite.fill(0xAA);
+  for (const bool highResolution : {false, true}) {
+    Screen screen;
+    screen.SetHighResolution(highResolution);
+    for (std::size_t x = 0; x < screen.Width(); x += 16) {
+      static_cast<void>(
+        screen.Draw(static_cast<Byte>(x), static_cast<Byte>(x % 32), sprite));
+    }
+    harness.Run(highResolution ? "wall/convert-tile/hires"
+                               : "wall/convert-tile/lores",
+                OPERATIONS, [&screen, &tile]() {
+                  for (std::size_t i = 0; i < OPERATIONS; ++i) {
+                    WallManager::ConvertTile(screen, tile);
+                    DoNotOptimize(tile.front());
+                  }
+                });
+  }
+}
+
+void BenchmarkRoms(Harness &harness, const std::filesystem::path &romDir) {
+  constexpr static std::size_t OPERATIONS = 200000;
+  std::vector<std::filesystem::path> roms;
+  for (const auto &entry : std::filesystem::directory_iterator(romDir)) {
+    if (entry.path().extension() == ".ch8") {
+      roms.push_back(entry.path());
+    }
+  }
+  std::sort(roms.begin(), roms.end());
+  Keyboard keyboard;
+  Screen screen;
+  Chip8 chip{&keyboard, &screen};
+  for (const auto &rom : roms) {
+    std::ifstream file(rom, std::ios::binary);
+    const std::vector<std::uint8_t> image{std::istreambuf_iterator<char>(file),
+                                          std::istreambuf_iterator<char>()};
+    try {
+      harness.Run("rom/" + rom.filename().string(), OPERATIONS,
+                  [&chip, &image]() {
+                    chip.Reset();
+                    chip.LoadProgram(image);
+                    chip.Step(OPERATIONS);
+                  });
+    } catch (const std::exception &e) {
+      std::cerr << "rom/" << rom.filename().string() << ": " << e.what()
+                << '\n';
+    }
+  }
+}
+
+void BenchmarkStateHash(Harness &harness,
+                        const std::filesystem::path &romDir) {
+  constexpr static std::size_t OPERATIONS = 10000;
+  std::ifstream file(romDir / "3-corax+.ch8", std::ios::binary);
+  const std::vector<std::uint8_t> image{std::istreambuf_iterator<char>(file),
+                                        std::istreambuf_iterator<char>()};
+  Keyboard keyboard;
+  Screen screen;
+  Chip8 chip{&keyboard, &screen};
+  // the price of cycle detection is the difference between these two
+  for (const bool hash : {false, true}) {
+    harness.Run(hash ? "frame/run+state-hash" : "frame/run", OPERATIONS,
+                [&chip, &image, hash]() {
+                  chip.Reset();
+                  chip.LoadProgram(image);
+                  for (std::size_t i = 0; i < OPERATIONS; ++i) {
+                    chip.RunFrame();
+                    if (hash) {
+                      DoNotOptimize(chip.StateHash());
+                    }
+                  }
+                });
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t warmup = 3;
+  std::size_t repetitions = 30;
+  std::string filter;
+  std::filesystem::path romDir = CHIP8_EXAMPLE_PROGRAMS_DIR;
+  std::filesystem::path output;
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  for (std::size_t i = 0; i + 1 < args.size(); i += 2) {
+    const auto &flag = args[i];
+    const auto &value = args[i + 1];
+    if (flag == "--warmup") {
+      warmup = std::stoul(value);
+    } else if (flag == "--repetitions") {
+      repetitions = std::max<std::size_t>(1, std::stoul(value));
+    } else if (flag == "--filter") {
+      filter = value;
+    } else if (flag == "--roms") {
+      romDir = value;
+    } else if (flag == "--out") {
+      output = value;
+    } else {
+      std::cerr << "usage: chip8_bench [--warmup N] [--repetitions N] "
+                   "[--filter SUBSTRING] [--roms DIR] [--out FILE]\n";
+      return 1;
+    }
+  }
+
+  Harness harness{warmup, repetitions, filter};
+  BenchmarkDispatch(harness);
+  BenchmarkDraw(harness);
+  BenchmarkTimers(harness);
+  BenchmarkRandom(harness);
+  BenchmarkQueue(harness);
+  BenchmarkFrameConversion(harness);
+  BenchmarkRoms(harness, romDir);
+  BenchmarkStateHash(harness, romDir);
+
+  if (output.empty()) {
+    harness.WriteJson(std::cout);
+  } else {
+    std::ofstream out{output};
+    harness.WriteJson(out);
+  }
+  return 0;
+}
@@ -0,0 +1,19 @@
+# chip8_add_translated_runner(<name> <rom>)
+#
+# Translates <rom> ahead of time with chip8_translate and builds <name>, which
+# runs the translated program against the interpreter and reports both
+# throughputs. Build with CMAKE_BUILD_TYPE=Release to compare them.
+function(chip8_add_translated_runner name rom)
+    set(generated "${CMAKE_CURRENT_BINARY_DIR}/translated/${name}.cpp")
+    file(MAKE_DIRECTORY "${CMAKE_CURRENT_BINARY_DIR}/translated")
+    add_custom_command(
+        OUTPUT "${generated}"
+        COMMAND chip8_translate "${rom}" "${generated}"
+        DEPENDS chip8_translate "${rom}"
+        COMMENT "Translating ${rom}"
+        VERBATIM
+    )
+    add_executable(${name} tools/TranslatedRunner.cpp "${generated}")
+    target_compile_options(${name} PRIVATE -Wall -Wextra -Wpedantic -Werror)
+    target_link_libraries(${name} chip8core)
+endfunction()
@@ -0,0 +1,133 @@
+#include "Chip8Core.hpp"
+#include "SaveState.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <span>
+
+// libFuzzer target for the interpreter. Two builds of this file:
+//  - ROM mode (default): the input is a program image loaded at 0x200
+//  - input mode (CHIP8_FUZZ_INPUT_ROM defined): the input is a key sequence
+//    replayed against that ROM. Each byte is one event: bits 0-3 the key,
+//    bit 4 pressed, bits 5-7 frames to run afterwards minus one
+//
+// Every execution starts by restoring a snapshot taken once at start-up (the
+// reset machine, or the ROM after CHIP8_FUZZ_WARMUP_FRAMES frames) instead
+// of resetting and loading from disk. The program counter of every executed
+// instruction is reported to libFuzzer as extra coverage, so ROM-level
+// control flow guides the search as well as the interpreter's own edges.
+
+#ifndef CHIP8_FUZZ_FRAMES
+#define CHIP8_FUZZ_FRAMES 16
+#endif
+
+#ifndef CHIP8_FUZZ_WARMUP_FRAMES
+#define CHIP8_FUZZ_WARMUP_FRAMES 60
+#endif
+
+namespace {
+
+constexpr std::size_t PROGRAM_START = 0x200;
+
+// one counter per CHIP-8 address; libFuzzer picks up this section by name
+[[gnu::used, gnu::section("__libfuzzer_extra_counters")]]
+std::array<std::uint8_t, Chip8::MEMORY_BYTES> pcCoverage;
+
+struct Harness {
+  std::unique_ptr<Chip8Core> core = Chip8Core::Create();
+  SaveState snapshot{};
+#ifndef CHIP8_FUZZ_INPUT_ROM
+  /** the snapshot with the current input at 0x200 */
+  SaveState scratch{};
+  std::size_t scratchProgramBytes = 0;
+#endif
+
+  Harness() {
+    core->Machine().SetTraceDumpStream(nullptr);
+#ifdef CHIP8_FUZZ_INPUT_ROM
+    const char *rom = std::getenv("CHIP8_FUZZ_ROM");
+    core->LoadProgram(rom != nullptr ? rom : CHIP8_FUZZ_INPUT_ROM);
+    for (std::size_t frame = 0; frame < CHIP8_FUZZ_WARMUP_FRAMES; ++frame) {
+      core->RunFrame();
+    }
+#endif
+    core->Machine().Save(snapshot);
+#ifndef CHIP8_FUZZ_INPUT_ROM
+    scratch = snapshot;
+#endif
+  }
+
+  /**
+   * @brief one frame, recording the PC of each instruction
+   */
+  void RunFrame() {
+    auto &chip = core->Machine();
+    for (std::size_t i = 0; i < Chip8::INSTRUCTIONS_PER_FRAME; ++i) {
+      ++pcCoverage.at(chip.ProgramCounter() % Chip8::MEMORY_BYTES);
+      chip.Step(1);
+    }
+    chip.TickFrameTimers();
+  }
+};
+
+Harness &GetHarness() {
+  static Harness harness;
+  return harness;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerInitialize(int * /*argc*/, char *** /*argv*/) {
+  GetHarness();
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size) {
+  auto &harness = GetHarness();
+  const std::span input(data, size);
+#ifdef CHIP8_FUZZ_INPUT_ROM
+  harness.core->Restore(harness.snapshot);
+  try {
+    for (const auto event : input) {
+      // NOLINTBEGIN(*-magic-numbers)
+      harness.core->SetKey(event & 0xFU, (event & 0x10U) != 0);
+      const std::size_t frames = (event >> 5U) + 1;
+      // NOLINTEND(*-magic-numbers)
+      for (std::size_t frame = 0; frame < frames; ++frame) {
+        harness.RunFrame();
+      }
+    }
+  } catch (const std::exception &) {
+    // invalid instructions and stack errors are the ROM's, not ours
+  }
+#else
+  if (size > Chip8::MEMORY_BYTES - PROGRAM_START) {
+    return -1;
+  }
+  // only the program area differs from the snapshot; clear what is left of
+  // a longer previous input rather than copying the whole state
+  auto program = std::span(harness.scratch.payload.memory)
+                   .subspan(PROGRAM_START);
+  std::ranges::copy(input, program.begin());
+  std::fill(program.begin() + static_cast<std::ptrdiff_t>(size),
+            program.begin() +
+              static_cast<std::ptrdiff_t>(
+                std::max(size, harness.scratchProgramBytes)),
+            0);
+  harness.scratchProgramBytes = size;
+  harness.core->Restore(harness.scratch);
+  try {
+    for (std::size_t frame = 0; frame < CHIP8_FUZZ_FRAMES; ++frame) {
+      harness.RunFrame();
+    }
+  } catch (const std::exception &) {
+    // invalid instructions and stack errors are the ROM's, not ours
+  }
+#endif
+  return 0;
+}
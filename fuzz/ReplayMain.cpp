@@ -0,0 +1,55 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Entry point for compilers without libFuzzer: replays the files given on the
+// command line, or with `--random N` runs N random inputs and reports
+// executions per second. Sanitizers still catch memory errors.
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv);
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size);
+
+int main(int argc, char **argv) {
+  LLVMFuzzerInitialize(&argc, &argv);
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.size() == 2 && args[0] == "--random") {
+    const auto runs = std::stoul(args[1]);
+    std::mt19937 rng{0};
+    std::uniform_int_distribution<int> byte(0, 0xFF);
+    constexpr static std::size_t MAX_INPUT = 512;
+    std::vector<std::uint8_t> input;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t run = 0; run < runs; ++run) {
+      input.resize(rng() % MAX_INPUT);
+      for (auto &value : input) {
+        value = static_cast<std::uint8_t>(byte(rng));
+      }
+      LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    std::cout << runs << " runs, "
+              << static_cast<std::uint64_t>(static_cast<double>(runs) /
+                                            elapsed.count())
+              << " exec/s\n";
+    return 0;
+  }
+  for (const auto &path : args) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      std::cerr << "Cannot open " << path << '\n';
+      return 1;
+    }
+    const std::vector<std::uint8_t> input{std::istreambuf_iterator<char>(file),
+                                          std::istreambuf_iterator<char>()};
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  return 0;
+}
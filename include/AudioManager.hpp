@@ -1,16 +1,40 @@
+#include "Metrics.hpp"
 #include <SDL2/SDL_audio.h>
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+/**
+ * @brief plays a tone while `*tone` is set. Samples are generated on SDL's
+ * audio thread, which only ever reads the flag. Nothing touches SDL until
+ * Open, so programs that never beep never start the audio subsystem
+ */
 class AudioManager {
 public:
-  AudioManager(const AudioManager &) = default;
+  AudioManager(const AudioManager &) = delete;
   AudioManager(AudioManager &&) = delete;
-  AudioManager &operator=(const AudioManager &) = default;
+  AudioManager &operator=(const AudioManager &) = delete;
   AudioManager &operator=(AudioManager &&) = delete;
 
-  AudioManager();
+  explicit AudioManager(const std::atomic<bool> *tone);
+
+  /**
+   * @brief start the audio subsystem, open the device and start playing
+   * @throws SdlError if the device cannot be opened
+   */
+  void Open();
+
+  [[nodiscard]] bool IsOpen() const { return _audioDevice != 0; }
 
   void UnpausePlayback();
   void PausePlayback();
 
+  /**
+   * @brief export callbacks and underruns; the manager must outlive the
+   * registry
+   */
+  void RegisterMetrics(MetricsRegistry &registry) const;
+
   ~AudioManager();
 
 private:
@@ -23,4 +47,14 @@ private:
   constexpr static int SAMPLE_SIZE = 16;
 
   SDL_AudioDeviceID _audioDevice = 0;
+  const std::atomic<bool> *_tone;
+  /** only touched by the audio thread */
+  double _phase = 0.0;
+  std::optional<std::chrono::steady_clock::time_point> _lastCallback;
+  Counter _callbacks;
+  /**
+   * callbacks that came more than 1.5 buffers after the previous one: the
+   * device most likely ran dry and played silence in between
+   */
+  Counter _underruns;
 };
\ No newline at end of file
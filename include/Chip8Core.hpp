@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Interpreter.hpp"
+#include "Keyboard.hpp"
+#include "SaveState.hpp"
+#include "Screen.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+/**
+ * @brief a headless machine for embedding: owns the keyboard, screen and
+ * interpreter, never touches SDL and only runs when stepped. The view returned
+ * by Framebuffer points straight at the machine's storage and stays valid for
+ * its lifetime
+ */
+class Chip8Core {
+public:
+  Chip8Core(const Chip8Core &) = delete;
+  Chip8Core(Chip8Core &&) = delete;
+  Chip8Core &operator=(const Chip8Core &) = delete;
+  Chip8Core &operator=(Chip8Core &&) = delete;
+  ~Chip8Core() = default;
+
+  /**
+   * @brief create a reset machine; destroy it by dropping the pointer
+   */
+  static std::unique_ptr<Chip8Core> Create();
+
+  /**
+   * @brief release all keys and reset the interpreter; memory returns to the
+   * font only
+   */
+  void Reset();
+
+  void LoadProgram(const std::filesystem::path &path);
+
+  void LoadProgram(std::span<const std::uint8_t> program);
+
+  /**
+   * @brief execute `count` instructions
+   */
+  void Step(std::size_t count) { _chip.Step(count); }
+
+  /**
+   * @brief execute one 60Hz frame and tick the timers
+   */
+  void RunFrame() { _chip.RunFrame(); }
+
+  struct FrameRun {
+    /** frames actually executed */
+    std::size_t executed = 0;
+    /** period of the loop the machine was found in, 0 if none was */
+    std::size_t loopPeriod = 0;
+  };
+
+  /**
+   * @brief run `count` frames with the keys held as they are, ending in the
+   * same state as `count` RunFrame calls. Once the state at a frame boundary
+   * repeats exactly (an attract loop, a `1NNN` to itself, a finished test
+   * screen), the whole periods left are skipped and only the remainder runs.
+   * Loops are found with Brent's algorithm on Chip8::StateHash and confirmed
+   * by running one more period and comparing full save states, so a hash
+   * collision never skips frames
+   */
+  FrameRun RunFrames(std::size_t count);
+
+  /**
+   * @brief release all keys and restore a snapshot taken with Machine().Save,
+   * skipping validation
+   */
+  void Restore(const SaveState &state) {
+    _keyboard.Reset();
+    _chip.Restore(state);
+  }
+
+  void SetKey(std::size_t key, bool pressed) {
+    _keyboard.SetKeyPressed(key, pressed);
+  }
+
+  [[nodiscard]] const Screen &Framebuffer() const { return _screen; }
+
+  /**
+   * @brief copy of the address space; memory is shared copy-on-write between
+   * machines running the same program, so there is no stable view of it
+   */
+  [[nodiscard]] auto Memory() const { return _chip.Memory(); }
+
+  /**
+   * @brief copy `out.size()` bytes from `address`, for reading a few bytes
+   * without a whole snapshot
+   */
+  void ReadMemory(std::size_t address, std::span<std::uint8_t> out) const {
+    _chip.ReadMemory(address, out);
+  }
+
+  [[nodiscard]] Chip8::State GetState() const { return _chip.GetState(); }
+
+  /**
+   * @brief the underlying interpreter, for save states, traces and profiles
+   */
+  Chip8 &Machine() { return _chip; }
+
+  [[nodiscard]] const Chip8 &Machine() const { return _chip; }
+
+private:
+  Chip8Core();
+
+  /**
+   * @brief run `period` frames; whether the machine came back to exactly the
+   * state it started in
+   */
+  bool ConfirmLoop(std::size_t period);
+
+  Keyboard _keyboard;
+  Screen _screen;
+  Chip8 _chip;
+  /** the states ConfirmLoop compares; allocated on first use */
+  std::unique_ptr<std::array<SaveState, 2>> _loopStates;
+};
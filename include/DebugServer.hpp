@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Interpreter.hpp"
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+/**
+ * @brief serves a Chip8's debugger over a local Unix stream socket, one
+ * client at a time. The protocol is line based; every command gets exactly
+ * one response line, "ok", "error <message>" or the requested data:
+ *
+ *   break <addr> / unbreak <addr>
+ *   watch r|w|rw <addr> [len] / unwatch <addr> [len]
+ *   cond V<x> ==|!=|<|> <value> / uncond
+ *   pause / continue / step [n]
+ *   wait [ms]       -> "paused <reason>" or "running"
+ *   status          -> "paused <reason>" or "running"
+ *   regs            -> "PC=... I=... SP=... DT=... ST=... V0=... VF=..."
+ *   mem <addr> <len> -> hex bytes
+ *
+ * Registers and memory can only be inspected while paused.
+ */
+class DebugServer {
+public:
+  DebugServer(const DebugServer &) = delete;
+  DebugServer(DebugServer &&) = delete;
+  DebugServer &operator=(const DebugServer &) = delete;
+  DebugServer &operator=(DebugServer &&) = delete;
+
+  DebugServer(Chip8 *chip, std::filesystem::path socketPath);
+
+  ~DebugServer();
+
+private:
+  void Serve();
+
+  void ServeClient(int client);
+
+  std::string HandleCommand(const std::string &line);
+
+  Chip8 *_chip;
+  std::filesystem::path _socketPath;
+  int _listener = -1;
+  std::atomic<bool> _stopping = false;
+  std::thread _thread;
+};
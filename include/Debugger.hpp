@@ -0,0 +1,212 @@
+#pragma once
+
+#include "Types.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @brief one bit per address. Words are atomic so a debugger client can edit
+ * the set while the emulation thread tests it
+ */
+template <std::size_t Size> class AddressBitmap {
+public:
+  static_assert(Size % 64 == 0);
+
+  [[nodiscard]] bool Test(std::size_t address) const {
+    // NOLINTNEXTLINE(*-array-index)
+    return ((_words[(address % Size) / WORD_BITS].load(
+               std::memory_order_relaxed) >>
+             (address % WORD_BITS)) &
+            1U) != 0;
+  }
+
+  /**
+   * @brief whether any of `length` addresses from `address` is set, wrapping
+   * at Size; one load per word touched
+   */
+  [[nodiscard]] bool TestRange(std::size_t address, std::size_t length) const {
+    address %= Size;
+    while (length > 0) {
+      const auto bit = address % WORD_BITS;
+      const auto count = std::min(length, WORD_BITS - bit);
+      const auto mask =
+        (count == WORD_BITS ? ~std::uint64_t{0}
+                            : (std::uint64_t{1} << count) - 1)
+        << bit;
+      // NOLINTNEXTLINE(*-array-index)
+      if ((_words[address / WORD_BITS].load(std::memory_order_relaxed) &
+           mask) != 0) {
+        return true;
+      }
+      length -= count;
+      address = (address + count) % Size;
+    }
+    return false;
+  }
+
+  void Set(std::size_t address, bool value) {
+    // NOLINTNEXTLINE(*-array-index)
+    auto &word = _words[(address % Size) / WORD_BITS];
+    const auto bit = std::uint64_t{1} << (address % WORD_BITS);
+    if (value) {
+      word.fetch_or(bit, std::memory_order_relaxed);
+    } else {
+      word.fetch_and(~bit, std::memory_order_relaxed);
+    }
+  }
+
+  void Clear() {
+    for (auto &word : _words) {
+      word.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  constexpr static std::size_t WORD_BITS = 64;
+  std::array<std::atomic<std::uint64_t>, Size / WORD_BITS> _words{};
+};
+
+/**
+ * @brief debug policy with PC breakpoints, memory watchpoints and conditional
+ * breaks on register values. Hooks run on the emulation thread; BeforeInstruction
+ * blocks it while the machine is paused. Everything else may be called from
+ * any thread
+ */
+class Debugger {
+public:
+  constexpr static bool ENABLED = true;
+  constexpr static std::size_t ADDRESS_SPACE = 65536;
+
+  enum class Comparison { EQUAL, NOT_EQUAL, LESS, GREATER };
+
+  struct Condition {
+    std::size_t reg;
+    Comparison comparison;
+    int value;
+  };
+
+  void OnRead(std::size_t address, std::size_t length) {
+    if (_readWatches.TestRange(address, length)) {
+      RecordWatchHit("read", address);
+    }
+  }
+
+  void OnWrite(std::size_t address, std::size_t length) {
+    if (_writeWatches.TestRange(address, length)) {
+      RecordWatchHit("write", address);
+    }
+  }
+
+  /**
+   * @brief lock-free unless a breakpoint is hit or a pause, step, watch hit
+   * or condition is pending
+   */
+  void BeforeInstruction(std::size_t programCounter,
+                         std::span<const Byte> registers) {
+    if (_pending.load(std::memory_order_relaxed) ||
+        _conditionsArmed.load(std::memory_order_relaxed) ||
+        _breakpoints.Test(programCounter)) {
+      CheckBreak(programCounter, registers);
+    }
+  }
+
+  void SetBreakpoint(std::size_t address, bool enabled);
+
+  void SetWatchpoint(std::size_t address, std::size_t length, bool onRead,
+                     bool onWrite);
+
+  void AddCondition(Condition condition);
+
+  void ClearConditions();
+
+  /**
+   * @brief pause before the next instruction
+   */
+  void Pause();
+
+  void Continue();
+
+  /**
+   * @brief resume for `count` (at least one) instructions, then pause again
+   */
+  void Step(std::size_t count);
+
+  /**
+   * @brief clear all breaks and release the emulation thread for good, e.g.
+   * when the machine is shutting down
+   */
+  void Detach();
+
+  /**
+   * @return true if the machine paused within `timeout`
+   */
+  bool WaitUntilPaused(std::chrono::milliseconds timeout);
+
+  [[nodiscard]] bool IsPaused() const;
+
+  /**
+   * @brief why the machine last paused, e.g. "breakpoint 0x2A4"
+   */
+  [[nodiscard]] std::string PauseReason() const;
+
+private:
+  void CheckBreak(std::size_t programCounter, std::span<const Byte> registers);
+
+  void RecordWatchHit(const char *kind, std::size_t address);
+
+  void UpdateArmed();
+
+  static bool Evaluate(const Condition &condition,
+                       std::span<const Byte> registers);
+
+  AddressBitmap<ADDRESS_SPACE> _breakpoints;
+  AddressBitmap<ADDRESS_SPACE> _readWatches;
+  AddressBitmap<ADDRESS_SPACE> _writeWatches;
+
+  /** a pause, step or watch hit is waiting for the next instruction */
+  std::atomic<bool> _pending = false;
+  /** conditions exist, so every instruction evaluates them */
+  std::atomic<bool> _conditionsArmed = false;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _stateChanged;
+  std::vector<Condition> _conditions;
+  std::vector<bool> _conditionWasTrue;
+  std::string _watchHit;
+  std::string _pauseReason;
+  std::size_t _stepsRemaining = 0;
+  bool _stepping = false;
+  bool _pauseRequested = false;
+  bool _paused = false;
+  bool _detached = false;
+};
+
+/**
+ * @brief stands in for Debugger when debugging is compiled out; every hook is
+ * empty so memory accesses compile to plain array accesses
+ */
+class NullDebugger {
+public:
+  constexpr static bool ENABLED = false;
+
+  void OnRead(std::size_t /*address*/, std::size_t /*length*/) {}
+  void OnWrite(std::size_t /*address*/, std::size_t /*length*/) {}
+  void BeforeInstruction(std::size_t /*programCounter*/,
+                         std::span<const Byte> /*registers*/) {}
+  void Detach() {}
+};
+
+#ifdef CHIP8_ENABLE_DEBUGGER
+using ActiveDebugger = Debugger;
+#else
+using ActiveDebugger = NullDebugger;
+#endif
@@ -1,18 +1,75 @@
 #pragma once
 
 #include "Interpreter.hpp"
+#ifdef CHIP8_ENABLE_DEBUGGER
+#include "DebugServer.hpp"
+#endif
 #include "Keyboard.hpp"
+#include "Metrics.hpp"
+#include "MetricsServer.hpp"
+#include "Threading.hpp"
 #include "UI.hpp"
+#include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
 class Emulator {
 public:
-  explicit Emulator(const std::filesystem::path &programPath);
+  struct Options {
+    /** run this many frames unpaced and without SDL, then exit; 0 opens a
+     * window */
+    std::size_t headlessFrames = 0;
+
+    /**
+     * @brief read `<prefix>_HEADLESS_FRAMES`
+     * @throws std::invalid_argument on a malformed frame count
+     */
+    static Options FromEnvironment(const std::string &prefix);
+
+    [[nodiscard]] bool Headless() const { return headlessFrames != 0; }
+  };
+
+  /**
+   * @brief reset the machine and load the program on a worker thread while
+   * this thread starts SDL video, which takes most of a windowed start.
+   * Headless emulators never touch SDL
+   */
+  Emulator(const std::filesystem::path &programPath, Options options);
   void Run();
 
+  /**
+   * @brief one line: time from construction to the first instruction and to
+   * the first frame (presented, or run when headless)
+   */
+  void WriteStartupSummary(std::ostream &out) const;
+
 private:
+  using Clock = std::chrono::steady_clock;
+
+  void RunWindowed();
+
+  void RunHeadless();
+
+  [[nodiscard]] double SecondsSinceStart() const;
+
+  Clock::time_point _started;
+  Options _options;
   std::unique_ptr<Keyboard> _keyboard;
   std::unique_ptr<Screen> _screen;
   std::unique_ptr<Chip8> _chip;
+  /** null when headless */
   std::unique_ptr<SdlManager> _ui;
-};
\ No newline at end of file
+  ThreadOptions _emulationThread;
+  /** created on the emulation thread, so that it measures that thread */
+  std::optional<FramePacer> _pacer;
+  Gauge _firstInstructionSeconds;
+  Gauge _firstFrameSeconds;
+  MetricsRegistry _metrics;
+  std::unique_ptr<MetricsServer> _metricsServer;
+#ifdef CHIP8_ENABLE_DEBUGGER
+  std::unique_ptr<DebugServer> _debugServer;
+#endif
+};
@@ -1,16 +1,28 @@
 #pragma once
 
 #include "Constants.hpp"
+#include "Debugger.hpp"
 #include "Keyboard.hpp"
+#include "MemoryBus.hpp"
+#include "Metrics.hpp"
+#include "Profiler.hpp"
 #include "Random.hpp"
+#include "SaveState.hpp"
 #include "Screen.hpp"
-#include "Timer.hpp"
+#include "Threading.hpp"
+#include "Trace.hpp"
 #include "Types.hpp"
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
-#include <stack>
+#include <future>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
 
 class Chip8 {
   using Instruction = int;
@@ -32,7 +44,7 @@ class Chip8 {
     ADD_VX_VY = 0x0004,
     LOAD_VX_KK = 0x6000,
     ADD_VX_KK = 0x7000,
-    RND_VX_KK = 0xC00,
+    RND_VX_KK = 0xC000,
 
     // branch
     SKIP_VX_EQ_KK = 0x3000,
@@ -40,6 +52,19 @@ class Chip8 {
     SKIP_VX_EQ_VY = 0x5000,
     SKIP_VX_NEQ_VY = 0x9000,
 
+    // XO-CHIP register ranges, 5XY2 and 5XY3; matched on the last nibble of
+    // a 5XYN instruction
+    SAVE_VX_TO_VY = 0x0002,
+    LOAD_VX_TO_VY = 0x0003,
+
+    // SUPER-CHIP screen control, matched on the whole instruction
+    SCROLL_DOWN_N = 0x00C0,
+    SCROLL_UP_N = 0x00D0,
+    SCROLL_RIGHT = 0x00FB,
+    SCROLL_LEFT = 0x00FC,
+    LOW_RESOLUTION = 0x00FE,
+    HIGH_RESOLUTION = 0x00FF,
+
     // keyboard
 
     E_OPS = 0xE000,
@@ -61,15 +86,20 @@ class Chip8 {
   };
 
   enum class FOps {
+    LONG_INDEX = 0x0000,
+    SELECT_PLANES = 0x0001,
     LOAD_DELAY_VX = 0x0007,
     WAIT_KEY_VX = 0x000A,
     SET_DELAY_VX = 0x0015,
     SET_SOUND_VX = 0x0018,
     ADD_VX_TO_I = 0x001E,
     SET_I_VX_SPRITE = 0x0029,
+    SET_I_VX_BIG_SPRITE = 0x0030,
     SET_MEM_I_DECIMAL_VX = 0x0033,
     STORE_MEM_I_V0_TO_VX = 0x0055,
     LOAD_V0_TO_VX_FROM_MEM_AT_I = 0x0065,
+    STORE_FLAGS_V0_TO_VX = 0x0075,
+    LOAD_FLAGS_V0_TO_VX = 0x0085,
   };
 
   enum class EOps {
@@ -78,6 +108,29 @@ class Chip8 {
   };
 
 public:
+  /** the XO-CHIP address space; CHIP-8 programs use the first 4 KB */
+  constexpr static std::size_t MEMORY_BYTES = 65536;
+  using AddressSpace = MemoryBus<ActiveDebugger, MEMORY_BYTES>;
+  using MemoryImage = SharedImages<MEMORY_BYTES>;
+
+  /**
+   * @brief snapshot of the CPU state, for embedders
+   */
+  struct State {
+    std::array<std::uint8_t, 16> registers;
+    std::uint16_t programCounter;
+    std::uint16_t index;
+    std::uint8_t stackDepth;
+    std::uint8_t delayTimer;
+    std::uint8_t soundTimer;
+  };
+
+  /**
+   * @brief direct access for ahead-of-time translated code; see
+   * Translated.hpp
+   */
+  class Native;
+
   explicit Chip8(Keyboard *keyboard, Screen *screen);
 
   void Cancel();
@@ -86,7 +139,157 @@ public:
 
   void LoadProgram(const std::filesystem::path &path);
 
-  void Run();
+  /**
+   * @brief copy a program image into memory at the program offset
+   */
+  void LoadProgram(std::span<const std::uint8_t> program);
+
+  /**
+   * @brief run frames until Cancel, sleeping until each frame's deadline
+   */
+  void Run(FramePacer &pacer);
+
+  /**
+   * @brief execute `count` instructions immediately, without waiting on the
+   * CPU clock or ticking the timers
+   */
+  void Step(std::size_t count);
+
+  /**
+   * @brief run one 60Hz frame without waiting on the clock: the instructions
+   * the CPU clock would execute in a frame, then one tick of the delay and
+   * sound timers. Runs are deterministic given the same input
+   */
+  void RunFrame();
+
+  /**
+   * @brief one 60Hz tick of the delay and sound timers
+   */
+  void TickFrameTimers();
+
+  [[nodiscard]] State GetState() const;
+
+  /**
+   * @brief hash of everything that determines how the machine continues for
+   * a given keyboard state: registers, PC, I, stack, timers, RPL flags, the
+   * RNG position, a pending FX0A, memory and the screen. Memory and screen
+   * hashes are kept up to date incrementally, so this costs little more than
+   * hashing the registers. Equal states give equal hashes
+   */
+  std::uint64_t StateHash();
+
+  /**
+   * @brief whether an FX0A is waiting for a key; not part of save states
+   */
+  [[nodiscard]] bool WaitingForKey() const { return _keyPress.has_value(); }
+
+  [[nodiscard]] std::size_t ProgramCounter() const { return _programCounter; }
+
+  /**
+   * @brief copy of the address space
+   */
+  [[nodiscard]] AddressSpace::Storage Memory() const {
+    return _memory.Snapshot();
+  }
+
+  /**
+   * @brief copy `out.size()` bytes of memory from `address` without copying
+   * the rest of the address space or triggering watchpoints
+   */
+  void ReadMemory(std::size_t address, std::span<std::uint8_t> out) const {
+    _memory.ReadRange(address, out);
+  }
+
+  /**
+   * @brief one byte of memory, without copying the address space or
+   * triggering watchpoints
+   */
+  [[nodiscard]] std::uint8_t PeekMemory(std::size_t address) const {
+    return _memory.Peek(address);
+  }
+
+  /**
+   * @brief bytes of memory this machine does not share with others running
+   * the same program
+   */
+  [[nodiscard]] std::size_t PrivateMemoryBytes() const {
+    return _memory.PrivatePages() * AddressSpace::PAGE_BYTES;
+  }
+
+  /**
+   * @brief breakpoints and watchpoints; a NullDebugger unless built with
+   * CHIP8_ENABLE_DEBUGGER
+   */
+  ActiveDebugger &GetDebugger() { return _memory.Policy(); }
+
+  /** 500Hz CPU clock / 60Hz timers, rounded down */
+  constexpr static std::size_t INSTRUCTIONS_PER_FRAME = 8;
+
+  constexpr static std::chrono::nanoseconds FRAME_PERIOD{16666667};
+
+  /**
+   * @brief whether the sound timer is running; read by the audio thread
+   */
+  [[nodiscard]] const std::atomic<bool> &Beeping() const {
+    return _beeping.value;
+  }
+
+  /**
+   * @brief export instructions executed and frames run; the machine must
+   * outlive the registry
+   */
+  void RegisterMetrics(MetricsRegistry &registry) const;
+
+  /**
+   * @brief snapshot the full machine state, including the screen, into `state`
+   * and seal it
+   */
+  void Save(SaveState &state) const;
+
+  /**
+   * @brief restore a snapshot written by Save
+   * @throws std::runtime_error if the state fails validation
+   */
+  void Load(const SaveState &state);
+
+  /**
+   * @brief Load without checking the header and checksum, for snapshots this
+   * process took itself (e.g. fuzzing and environment resets)
+   */
+  void Restore(const SaveState &state);
+
+  /**
+   * @brief execution profile; a NullProfiler unless built with
+   * CHIP8_ENABLE_PROFILER
+   */
+  [[nodiscard]] const ActiveProfiler &GetProfiler() const { return _profiler; }
+
+  /**
+   * @brief the CXKK stream; stream 0 of seed 0 until an embedder keys it,
+   * e.g. `Random() = RandomNumberGenerator{seed, instance}`. Kept across
+   * Reset; save states carry its key and position
+   */
+  RandomNumberGenerator &Random() { return _rng; }
+
+  /**
+   * @brief write the most recently executed instructions, oldest first. This
+   * also happens automatically when an instruction throws
+   */
+  void DumpTrace(std::ostream &out) const;
+
+  /**
+   * @brief where the trace is dumped when an instruction throws; stderr by
+   * default, nullptr to disable
+   */
+  void SetTraceDumpStream(std::ostream *out) { _traceDumpStream = out; }
+
+  /**
+   * @brief additionally stream every executed instruction to a binary file
+   * until StopTraceFile is called
+   */
+  void StartTraceFile(const std::filesystem::path &path);
+
+  void StopTraceFile();
 
 private:
   Instruction FetchInstruction();
@@ -99,15 +302,28 @@ private:
   static constexpr int ExtractKK(Instruction instruction);
   static constexpr int ExtractNNN(Instruction instruction);
 
-  void IncrementPC();
+  void IncrementPC() { _programCounter += 2; }
+
+  /**
+   * @brief skip the next instruction, including both words of an XO-CHIP
+   * F000 NNNN
+   */
+  void SkipInstruction() {
+    // NOLINTNEXTLINE(*-magic-numbers)
+    const auto longIndex = _memory.Fetch(_programCounter) == 0xF000;
+    IncrementPC();
+    if (longIndex) {
+      IncrementPC();
+    }
+  }
 
   void InitializeMemory();
 
   /**
-   * @brief execute an opcode
-   * @return true if the program counter should be incremented
+   * @brief execute an opcode; defined in InterpreterExecute.hpp
    */
-  void ExecuteInstruction(Instruction instruction);
+  [[gnu::always_inline]] inline void
+  ExecuteInstruction(Instruction instruction);
 
   void StackPush(unsigned short val);
 
@@ -122,26 +338,23 @@ private:
 
   Keyboard *_keyboard;
 
-  RandomNumberGenerator _rng{0, Constants::MAX_BYTE,
-                             static_cast<int>(time(nullptr))};
+  RandomNumberGenerator _rng{0, 0};
 
   Screen *_screen;
 
   std::size_t _index = 0;
 
-  TimerManager _timerManager;
+  /** 60Hz countdowns, ticked by TickFrameTimers */
+  std::uint8_t _delayTimer = 0;
 
-  std::shared_ptr<Timer> _delayTimer;
+  std::uint8_t _soundTimer = 0;
 
-  std::shared_ptr<Timer> _soundTimer;
+  /** outstanding FX0A request; the instruction repeats until it is ready */
+  std::optional<std::future<std::size_t>> _keyPress;
 
   // by popular convention, but can be anywhere 0x0000 - 0x01FF
   static constexpr std::size_t MEMORY_OFFSET_FONT = 0x0050;
 
-  /** 500hz */
-  static constexpr std::chrono::steady_clock::duration CPU_TICK_PERIOD =
-      std::chrono::nanoseconds{2000000};
-
   constexpr static std::size_t NUM_REGISTERS = 15;
 
   constexpr static std::size_t NUM_CARRY = 1;
@@ -149,14 +362,13 @@ private:
   std::array<Byte, NUM_REGISTERS + NUM_CARRY> _registers{};
 
   constexpr static std::size_t STACK_SIZE = 16;
-  // using StackUnderlying = std::array<unsigned short, STACK_SIZE>;
-  std::stack<unsigned short> _stack;
+  std::array<unsigned short, STACK_SIZE> _stack{};
+  std::size_t _stackPointer = 0;
 
   constexpr static std::size_t MEMORY_OFFSET_PROGRAM = 0x200;
-  constexpr static std::size_t MEMORY_BYTES = 4096;
-  std::array<Byte, MEMORY_BYTES> _memory = {};
+  AddressSpace _memory;
 
-  constexpr static auto FONT_SET = (std::to_array<Byte>({
+  constexpr static auto FONT_SET = (std::to_array<std::uint8_t>({
       0xF0, 0x90, 0x90, 0x90, 0xF0, 0x20, 0x60, 0x20, 0x20, 0x70, 0xF0, 0x10,
       0xF0, 0x80, 0xF0, 0xF0, 0x10, 0xF0, 0x10, 0xF0, 0x90, 0x90, 0xF0, 0x10,
       0x10, 0xF0, 0x80, 0xF0, 0x10, 0xF0, 0xF0, 0x80, 0xF0, 0x90, 0xF0, 0xF0,
@@ -166,5 +378,53 @@ private:
       0xF0, 0x80, 0xF0, 0xF0, 0x80, 0xF0, 0x80, 0x80,
   }));
 
-  std::atomic<bool> _cancelled = false;
+  // SUPER-CHIP 8x10 digits for FX30, directly after the small font
+  static constexpr std::size_t MEMORY_OFFSET_BIG_FONT = 0x00A0;
+  static constexpr std::size_t BIG_FONT_BYTES = 10;
+
+  constexpr static auto BIG_FONT_SET = (std::to_array<std::uint8_t>({
+      0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+      0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+      0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+      0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+      0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+      0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+      0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+      0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+      0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+      0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+      0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+      0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0, // F
+  }));
+
+  static_assert(MEMORY_OFFSET_BIG_FONT >= MEMORY_OFFSET_FONT + FONT_SET.size());
+  static_assert(MEMORY_OFFSET_BIG_FONT + BIG_FONT_SET.size() <=
+                MEMORY_OFFSET_PROGRAM);
+
+  /** a DXY0 sprite in one plane: 16 rows of two bytes */
+  constexpr static std::size_t LARGE_SPRITE_BYTES = 32;
+
+  /** SUPER-CHIP RPL user flags (FX75/FX85); kept across Reset */
+  constexpr static std::size_t NUM_FLAGS = 16;
+  std::array<std::uint8_t, NUM_FLAGS> _flags{};
+
+  [[no_unique_address]] ActiveProfiler _profiler;
+
+  constexpr static std::size_t TRACE_DEPTH = 256;
+  TraceRing<TRACE_DEPTH> _trace;
+
+  Counter _instructions;
+  Counter _frames;
+
+  std::unique_ptr<TraceWriter> _traceFile;
+
+  std::ostream *_traceDumpStream;
+
+  // written by other threads; kept off the lines the interpreter works on
+  CacheLinePadded<std::atomic<bool>> _cancelled;
+  CacheLinePadded<std::atomic<bool>> _beeping;
 };
\ No newline at end of file
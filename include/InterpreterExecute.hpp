@@ -0,0 +1,356 @@
+#pragma once
+
+// Definition of Chip8::ExecuteInstruction. It lives in a header so that code
+// generated by chip8_translate can inline it with a constant instruction and
+// have the dispatch folded away.
+
+#include "InstructionError.hpp"
+#include "Interpreter.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstdint>
+#include <span>
+
+constexpr int Chip8::ExtractX(int instruction) {
+  // NOLINTNEXTLINE(*-magic-numbers)
+  return (instruction & 0x0F00) >> 8;
+}
+constexpr int Chip8::ExtractY(int instruction) {
+  // NOLINTNEXTLINE(*-magic-numbers)
+  return (instruction & 0x00F0) >> 4;
+}
+
+constexpr int Chip8::ExtractN(int instruction) {
+  // NOLINTNEXTLINE(*-magic-numbers)
+  return instruction & 0x000F;
+}
+
+constexpr int Chip8::ExtractKK(int instruction) {
+  // NOLINTNEXTLINE(*-magic-numbers)
+  return instruction & 0x00FF;
+}
+
+constexpr int Chip8::ExtractNNN(int instruction) {
+  // NOLINTNEXTLINE(*-magic-numbers)
+  return instruction & 0x0FFF;
+}
+
+// NOLINTNEXTLINE(*cognitive-complexity)
+inline void Chip8::ExecuteInstruction(Instruction instruction) {
+  // NOLINTBEGIN(*magic-numbers, *-array-index)
+  const auto Y = ExtractY(instruction);
+  const auto X = ExtractX(instruction);
+  const auto N = ExtractN(instruction);
+  const auto KK = ExtractKK(instruction);
+  const auto NNN = ExtractNNN(instruction);
+  auto *VX = Register(X);
+  auto *VY = Register(Y);
+  auto *carry = Register(0xF);
+  const auto setCarry = [carry](bool value) {
+    *carry = static_cast<int>(value);
+  };
+
+  const auto firstNibble = static_cast<Opcodes>(instruction & 0xF000);
+  const auto lastNibble = static_cast<Opcodes>(instruction & 0x000F);
+  if (static_cast<int>(firstNibble) == 0) {
+    // SUPER-CHIP and XO-CHIP screen control; checked first because the older opcodes
+    // below are decoded from the last nibble alone
+    if ((instruction & 0xFFF0) == static_cast<int>(Opcodes::SCROLL_DOWN_N)) {
+      _screen->ScrollDown(N);
+      return;
+    }
+    if ((instruction & 0xFFF0) == static_cast<int>(Opcodes::SCROLL_UP_N)) {
+      _screen->ScrollUp(N);
+      return;
+    }
+    switch (static_cast<Opcodes>(instruction)) {
+    case Opcodes::SCROLL_RIGHT:
+      _screen->ScrollRight();
+      return;
+    case Opcodes::SCROLL_LEFT:
+      _screen->ScrollLeft();
+      return;
+    case Opcodes::LOW_RESOLUTION:
+      _screen->SetHighResolution(false);
+      return;
+    case Opcodes::HIGH_RESOLUTION:
+      _screen->SetHighResolution(true);
+      return;
+    default:
+      break;
+    }
+    switch (lastNibble) {
+    case Opcodes::ADD_VX_VY: {
+      setCarry(*VX > 0xFF - *VY);
+      *VX += *VY;
+      break;
+    }
+
+    case Opcodes::RETURN:
+      _programCounter = StackPop();
+      _profiler.OnReturn();
+      break;
+
+    case Opcodes::CLEAR_SCREEN:
+      _screen->Clear();
+      break;
+
+    default:
+      throw InstructionError(instruction);
+    }
+  } else {
+    switch (firstNibble) {
+
+    case Opcodes::LOAD_VX_KK:
+      *VX = KK;
+      break;
+
+    case Opcodes::E_OPS:
+      switch (static_cast<EOps>(lastNibble)) {
+      case EOps::SKIP_VX_PRESSED:
+        // only the low nibble selects a key
+        // NOLINTNEXTLINE(*-magic-numbers)
+        if (_keyboard->IsKeyPressed(*VX & 0xF)) {
+          SkipInstruction();
+        }
+        break;
+      case EOps::SKIP_VX_NOT_PRESSED:
+        // NOLINTNEXTLINE(*-magic-numbers)
+        if (!_keyboard->IsKeyPressed(*VX & 0xF)) {
+          SkipInstruction();
+        }
+        break;
+      default:
+        throw InstructionError(instruction);
+      }
+      break;
+
+    case Opcodes::F_OPS:
+      switch (static_cast<FOps>(instruction & 0x00FF)) {
+      case FOps::LONG_INDEX:
+        if (X != 0) {
+          throw InstructionError(instruction);
+        }
+        // F000 NNNN: the address is the following word
+        _index = static_cast<std::size_t>(_memory.Fetch(_programCounter));
+        IncrementPC();
+        break;
+      case FOps::SELECT_PLANES:
+        _screen->SelectPlanes(static_cast<unsigned int>(X));
+        break;
+      case FOps::LOAD_DELAY_VX:
+        *VX = _delayTimer;
+        break;
+      case FOps::WAIT_KEY_VX: {
+        if (!_keyPress.has_value()) {
+          _keyPress = _keyboard->GetNextKeyPress();
+        }
+        if (_keyPress->wait_for(std::chrono::seconds::zero()) !=
+            std::future_status::ready) {
+          // rerun this instruction rather than block, so the thread can
+          // still be cancelled
+          _programCounter -= 2;
+          break;
+        }
+        *VX = static_cast<Byte>(_keyPress->get());
+        _keyPress.reset();
+        break;
+      }
+      case FOps::SET_DELAY_VX:
+        _delayTimer = static_cast<std::uint8_t>(*VX);
+        break;
+      case FOps::SET_SOUND_VX:
+        _soundTimer = static_cast<std::uint8_t>(*VX);
+        break;
+      case FOps::ADD_VX_TO_I:
+        _index += *VX;
+        break;
+      case FOps::SET_I_VX_SPRITE:
+        _index = MEMORY_OFFSET_FONT + *VX;
+        break;
+      case FOps::SET_I_VX_BIG_SPRITE:
+        _index = MEMORY_OFFSET_BIG_FONT + (*VX & 0xF) * BIG_FONT_BYTES;
+        break;
+      case FOps::STORE_FLAGS_V0_TO_VX:
+        std::transform(_registers.begin(), _registers.begin() + X + 1,
+                       _flags.begin(),
+                       [](Byte reg) { return static_cast<std::uint8_t>(reg); });
+        break;
+      case FOps::LOAD_FLAGS_V0_TO_VX:
+        std::copy(_flags.begin(), _flags.begin() + X + 1, _registers.begin());
+        break;
+      case FOps::SET_MEM_I_DECIMAL_VX: {
+        const auto tc = *VX;
+        const Byte hundreds = tc / 100;
+        const Byte tens = (tc % 100) / 10;
+        const Byte ones = tc % 10;
+        _memory.Write(_index, hundreds);
+        _memory.Write(_index + 1, tens);
+        _memory.Write(_index + 2, ones);
+        break;
+      }
+      case FOps::STORE_MEM_I_V0_TO_VX: {
+        std::array<std::uint8_t, NUM_REGISTERS + NUM_CARRY> bytes{};
+        std::transform(_registers.begin(), _registers.begin() + X + 1,
+                       bytes.begin(),
+                       [](Byte reg) { return static_cast<std::uint8_t>(reg); });
+        _memory.WriteSpan(_index, std::span(bytes).first(X + 1));
+        break;
+      }
+      case FOps::LOAD_V0_TO_VX_FROM_MEM_AT_I: {
+        const auto source = _memory.ReadSpan(_index, X + 1);
+        std::copy(source.begin(), source.end(), _registers.begin());
+        break;
+      }
+      default:
+        throw InstructionError(instruction);
+      }
+      break;
+
+    case Opcodes::EIGHT_OPS:
+      switch (static_cast<EightOps>(lastNibble)) {
+      case EightOps::LOAD_VX_VY:
+        *VX = *VY;
+        break;
+      case EightOps::OR_VX_VY:
+        *VX |= *VY;
+        break;
+      case EightOps::AND_VX_VY:
+        *VX &= *VY;
+        break;
+      case EightOps::XOR_VX_VY:
+        *VX ^= *VY;
+        break;
+      case EightOps::ADD_VX_VY: {
+        const auto sum = *VX + *VY;
+        *VX = sum & 0xFF;
+        setCarry(sum > 0xFF);
+        break;
+      }
+      case EightOps::SUB_VX_VY: {
+        const Byte x = *VX;
+        const Byte y = *VY;
+        *VX = (x - y) & 0xFF;
+        setCarry(y <= x);
+        break;
+      }
+      case EightOps::SHIFT_RIGHT_VX: {
+        const auto x = *VX;
+        *VX >>= 1;
+        setCarry(((x & 1) != 0));
+        break;
+      }
+      case EightOps::SUBN_VX_VY: {
+        const unsigned int x = *VX;
+        const unsigned int y = *VY;
+        *VX = static_cast<Byte>(y - x) & 0xFF;
+        setCarry(y >= x);
+        break;
+      }
+      case EightOps::SHIFT_LEFT_VX: {
+        const auto x = *VX;
+        *VX = (x << 1) & 0xFF;
+        setCarry((x & 0b10000000) != 0);
+        break;
+      }
+      default:
+        throw InstructionError(instruction);
+      }
+      break;
+
+    case Opcodes::ADD_VX_KK:
+      *VX = (*VX + KK) & 0xFF;
+      break;
+
+    case Opcodes::JUMP_NNN:
+      _programCounter = NNN;
+      break;
+
+    case Opcodes::JUMP_V0_NNN:
+      _programCounter = NNN + *Register(0);
+      break;
+
+    case Opcodes::CALL_NNN:
+      StackPush(_programCounter);
+      _programCounter = NNN;
+      _profiler.OnCall(NNN);
+      break;
+
+    case Opcodes::SET_INDEX_NNN:
+      _index = NNN;
+      break;
+
+    case Opcodes::SKIP_VX_EQ_KK:
+      if (*VX == KK) {
+        SkipInstruction();
+      }
+      break;
+
+    case Opcodes::SKIP_VX_NEQ_KK:
+      if (*VX != KK) {
+        SkipInstruction();
+      }
+      break;
+
+    case Opcodes::SKIP_VX_EQ_VY:
+      switch (static_cast<Opcodes>(N)) {
+      case Opcodes::SAVE_VX_TO_VY: {
+        // the range runs downwards if X > Y
+        const auto step = X <= Y ? 1 : -1;
+        const auto count = static_cast<std::size_t>(std::abs(Y - X) + 1);
+        std::array<std::uint8_t, NUM_REGISTERS + NUM_CARRY> bytes{};
+        for (std::size_t i = 0; i < count; ++i) {
+          bytes[i] = static_cast<std::uint8_t>(
+            *Register(static_cast<std::size_t>(X + step * static_cast<int>(i))));
+        }
+        _memory.WriteSpan(_index, std::span(bytes).first(count));
+        break;
+      }
+      case Opcodes::LOAD_VX_TO_VY: {
+        const auto step = X <= Y ? 1 : -1;
+        const auto count = static_cast<std::size_t>(std::abs(Y - X) + 1);
+        const auto source = _memory.ReadSpan(_index, count);
+        for (std::size_t i = 0; i < count; ++i) {
+          *Register(static_cast<std::size_t>(X + step * static_cast<int>(i))) =
+            source[i];
+        }
+        break;
+      }
+      default:
+        if (*VX == *VY) {
+          SkipInstruction();
+        }
+        break;
+      }
+      break;
+
+    case Opcodes::SKIP_VX_NEQ_VY:
+      if (*VX != *VY) {
+        SkipInstruction();
+      }
+      break;
+
+    case Opcodes::RND_VX_KK:
+      *VX = _rng.Generate() & KK;
+      break;
+
+    case Opcodes::DRAW: {
+      // one sprite per selected plane, back to back
+      const auto planes = _screen->SelectedPlaneCount();
+      if (N == 0) {
+        setCarry(_screen->DrawLarge(
+          *VX, *VY, _memory.ReadSpan(_index, LARGE_SPRITE_BYTES * planes)));
+      } else {
+        setCarry(_screen->Draw(
+          *VX, *VY,
+          _memory.ReadSpan(_index, static_cast<std::size_t>(N) * planes)));
+      }
+      break;
+    }
+    default:
+      throw InstructionError(instruction);
+    }
+  }
+  // NOLINTEND(*magic-numbers, *-array-index)
+}
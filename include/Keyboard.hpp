@@ -1,9 +1,11 @@
 #pragma once
 
+#include "Threading.hpp"
 #include <array>
 #include <atomic>
 #include <cstddef>
 #include <future>
+#include <mutex>
 #include <vector>
 
 /**
@@ -15,9 +17,15 @@ public:
   [[nodiscard]] std::future<std::size_t> GetNextKeyPress();
   void SetKeyPressed(std::size_t key, bool isPressed);
 
+  /**
+   * @brief release every key and drop outstanding key-press requests
+   */
+  void Reset();
+
 private:
   static constexpr std::size_t KEYBOARD_SIZE = 16;
-  std::array<std::atomic<bool>, KEYBOARD_SIZE> _keyboard{};
+  // written by the render thread, read by the emulation thread
+  CacheLinePadded<std::array<std::atomic<bool>, KEYBOARD_SIZE>> _keyboard;
+  std::mutex _requestsMutex;
   std::vector<std::promise<std::size_t>> _keyPressRequests;
-  std::atomic<bool> _cancelled = false;
 };
\ No newline at end of file
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "SharedImage.hpp"
+#include "StateHash.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * @brief the interpreter's address space. Data accesses go through the
+ * debug policy's OnRead/OnWrite hooks; with NullDebugger those are empty and
+ * every accessor inlines to a page table lookup.
+ *
+ * Memory is copy-on-write: pages point into a shared, immutable image (see
+ * SharedImages) until the machine first writes to them, at which point only
+ * that page is copied.
+ *
+ * Addresses wrap modulo Size, as on a machine with a Size-byte address bus,
+ * so no program can reach outside the address space
+ */
+template <typename DebugPolicy, std::size_t Size> class MemoryBus {
+public:
+  using Storage = std::array<std::uint8_t, Size>;
+
+  constexpr static std::size_t SIZE = Size;
+  constexpr static std::size_t PAGE_BYTES = 256;
+  constexpr static std::size_t NUM_PAGES = Size / PAGE_BYTES;
+  /**
+   * @brief longest ReadSpan that may straddle two pages: a 16x16 sprite in
+   * each of four planes
+   */
+  constexpr static std::size_t MAX_SPAN = 128;
+
+  static_assert(Size % PAGE_BYTES == 0);
+  static_assert(std::has_single_bit(Size));
+
+  MemoryBus() { Map(SharedImages<Size>::Intern(Storage{})); }
+
+  /**
+   * @brief instruction fetch; not reported to watchpoints
+   */
+  [[nodiscard]] int Fetch(std::size_t address) const {
+    // NOLINTNEXTLINE(*-magic-numbers)
+    return Byte(address) << 8 | Byte(address + 1);
+  }
+
+  std::uint8_t Read(std::size_t address) {
+    address &= ADDRESS_MASK;
+    _policy.OnRead(address, 1);
+    return Byte(address);
+  }
+
+  /**
+   * @brief read without reporting to the debug policy
+   */
+  [[nodiscard]] std::uint8_t Peek(std::size_t address) const {
+    return Byte(address);
+  }
+
+  void Write(std::size_t address, std::uint8_t value) {
+    address &= ADDRESS_MASK;
+    _policy.OnWrite(address, 1);
+    RecordWrite(address, 1);
+    // NOLINTNEXTLINE(*-array-index)
+    WritablePage(address / PAGE_BYTES)[address % PAGE_BYTES] = value;
+  }
+
+  /**
+   * @brief view of `length` bytes, valid until the next access to the bus
+   * @throws std::out_of_range if the span straddles two pages and is longer
+   * than MAX_SPAN
+   */
+  std::span<const std::uint8_t> ReadSpan(std::size_t address,
+                                         std::size_t length) {
+    address &= ADDRESS_MASK;
+    _policy.OnRead(address, length);
+    const auto offset = address % PAGE_BYTES;
+    if (offset + length <= PAGE_BYTES) {
+      // NOLINTNEXTLINE(*-array-index)
+      return {_pages[address / PAGE_BYTES] + offset, length};
+    }
+    if (length > MAX_SPAN) {
+      throw std::out_of_range("Read spans too many pages");
+    }
+    for (std::size_t i = 0; i < length; ++i) {
+      // NOLINTNEXTLINE(*-array-index)
+      _scratch[i] = Byte(address + i);
+    }
+    return std::span(_scratch).first(length);
+  }
+
+  void WriteSpan(std::size_t address, std::span<const std::uint8_t> bytes) {
+    address &= ADDRESS_MASK;
+    _policy.OnWrite(address, bytes.size());
+    RecordWrite(address, bytes.size());
+    for (const auto byte : bytes) {
+      // NOLINTNEXTLINE(*-array-index)
+      WritablePage(address / PAGE_BYTES)[address % PAGE_BYTES] = byte;
+      address = (address + 1) & ADDRESS_MASK;
+    }
+  }
+
+  /**
+   * @brief map every page onto `image`, discarding private copies
+   */
+  void Map(std::shared_ptr<const Storage> image) {
+    _image = std::move(image);
+    _stalePages.fill(~std::uint64_t{0});
+    for (std::size_t page = 0; page < NUM_PAGES; ++page) {
+      _private.at(page).reset();
+      _pages.at(page) = _image->data() + page * PAGE_BYTES;
+    }
+  }
+
+  /**
+   * @brief replace the contents with `contents`; pages identical to the
+   * shared image stay shared. Bypasses the debug policy
+   */
+  void Restore(const Storage &contents) {
+    for (std::size_t page = 0; page < NUM_PAGES; ++page) {
+      const auto source = std::span(contents).subspan(page * PAGE_BYTES,
+                                                      PAGE_BYTES);
+      const auto shared = std::span(*_image).subspan(page * PAGE_BYTES,
+                                                     PAGE_BYTES);
+      if (std::ranges::equal(source, shared)) {
+        _private.at(page).reset();
+        _pages.at(page) = shared.data();
+        MarkStale(page);
+      } else {
+        std::ranges::copy(source, WritablePage(page));
+      }
+    }
+  }
+
+  /**
+   * @brief copy of the whole address space; bypasses the debug policy
+   */
+  [[nodiscard]] Storage Snapshot() const {
+    Storage contents;
+    for (std::size_t page = 0; page < NUM_PAGES; ++page) {
+      // NOLINTNEXTLINE(*-array-index)
+      std::copy_n(_pages[page], PAGE_BYTES,
+                  contents.begin() +
+                    static_cast<std::ptrdiff_t>(page * PAGE_BYTES));
+    }
+    return contents;
+  }
+
+  /**
+   * @brief copy `out.size()` bytes from `address`, wrapping at Size, a page
+   * at a time; bypasses the debug policy
+   */
+  void ReadRange(std::size_t address, std::span<std::uint8_t> out) const {
+    while (!out.empty()) {
+      address &= ADDRESS_MASK;
+      const auto offset = address % PAGE_BYTES;
+      const auto count = std::min(out.size(), PAGE_BYTES - offset);
+      // NOLINTNEXTLINE(*-array-index, *-pointer-arithmetic)
+      std::copy_n(_pages[address / PAGE_BYTES] + offset, count, out.begin());
+      out = out.subspan(count);
+      address += count;
+    }
+  }
+
+  /**
+   * @brief pages this machine has copied out of the shared image
+   */
+  [[nodiscard]] std::size_t PrivatePages() const {
+    return static_cast<std::size_t>(std::ranges::count_if(
+      _private, [](const auto &page) { return page != nullptr; }));
+  }
+
+  DebugPolicy &Policy() { return _policy; }
+
+  /**
+   * @brief hash of the whole address space. Only pages written, mapped or
+   * restored since the last call are rehashed; the others keep their cached
+   * hashes, which are combined by XOR. Equal contents give equal hashes
+   */
+  std::uint64_t Hash() {
+    for (std::size_t word = 0; word < _stalePages.size(); ++word) {
+      // NOLINTNEXTLINE(*-array-index)
+      for (auto stale = _stalePages[word]; stale != 0; stale &= stale - 1) {
+        const auto page = word * STALE_WORD_BITS +
+                          static_cast<std::size_t>(std::countr_zero(stale));
+        StateHasher hasher{page};
+        // NOLINTNEXTLINE(*-array-index)
+        hasher.AddBytes(std::as_bytes(std::span(_pages[page], PAGE_BYTES)));
+        // NOLINTNEXTLINE(*-array-index)
+        auto &cached = _pageHashes[page];
+        _hash ^= cached ^ hasher.Value();
+        cached = hasher.Value();
+      }
+    }
+    _stalePages.fill(0);
+    return _hash;
+  }
+
+  /**
+   * @brief [first, last) addresses written through Write/WriteSpan since the
+   * last ClearWriteRange; empty if first >= last
+   */
+  [[nodiscard]] std::pair<std::size_t, std::size_t> WriteRange() const {
+    return {_writeFirst, _writeLast};
+  }
+
+  void ClearWriteRange() {
+    _writeFirst = Size;
+    _writeLast = 0;
+  }
+
+private:
+  using Page = std::array<std::uint8_t, PAGE_BYTES>;
+
+  constexpr static std::size_t ADDRESS_MASK = Size - 1;
+
+  constexpr static std::size_t STALE_WORD_BITS = 64;
+
+  [[nodiscard]] std::uint8_t Byte(std::size_t address) const {
+    address &= ADDRESS_MASK;
+    // NOLINTNEXTLINE(*-array-index, *-pointer-arithmetic)
+    return _pages[address / PAGE_BYTES][address % PAGE_BYTES];
+  }
+
+  void MarkStale(std::size_t page) {
+    // NOLINTNEXTLINE(*-array-index)
+    _stalePages[page / STALE_WORD_BITS] |= std::uint64_t{1}
+                                           << (page % STALE_WORD_BITS);
+  }
+
+  std::uint8_t *WritablePage(std::size_t page) {
+    MarkStale(page);
+    // NOLINTNEXTLINE(*-array-index)
+    auto &copy = _private[page];
+    if (!copy) {
+      copy = std::make_unique<Page>();
+      // NOLINTNEXTLINE(*-array-index)
+      std::copy_n(_pages[page], PAGE_BYTES, copy->begin());
+      // NOLINTNEXTLINE(*-array-index)
+      _pages[page] = copy->data();
+    }
+    return copy->data();
+  }
+
+  void RecordWrite(std::size_t address, std::size_t length) {
+    // a write that wraps past the end also covers the start
+    _writeFirst = address + length > Size ? 0 : std::min(_writeFirst, address);
+    _writeLast = std::max(_writeLast, std::min(address + length, Size));
+  }
+
+  /** where each page currently reads from: the shared image or a copy */
+  std::array<const std::uint8_t *, NUM_PAGES> _pages{};
+  std::array<std::unique_ptr<Page>, NUM_PAGES> _private;
+  std::shared_ptr<const Storage> _image;
+  std::array<std::uint8_t, MAX_SPAN> _scratch{};
+  std::size_t _writeFirst = Size;
+  std::size_t _writeLast = 0;
+  /** one bit per page whose cached hash is out of date */
+  std::array<std::uint64_t, (NUM_PAGES + STALE_WORD_BITS - 1) / STALE_WORD_BITS>
+    _stalePages{};
+  std::array<std::uint64_t, NUM_PAGES> _pageHashes{};
+  /** XOR of _pageHashes */
+  std::uint64_t _hash = 0;
+  [[no_unique_address]] DebugPolicy _policy;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <variant>
+#include <vector>
+
+class LatencyHistogram;
+
+// Metrics are owned by the component that updates them and are updated by a
+// single thread, so an update is a relaxed load and store rather than an
+// atomic read-modify-write: on x86 it compiles to the same instructions as a
+// plain increment. Other threads (the metrics endpoint) read them at any time
+// and see a recent value.
+
+/**
+ * @brief monotonically increasing count, updated by one thread
+ */
+class Counter {
+public:
+  void Add(std::uint64_t amount = 1) noexcept {
+    _value.store(_value.load(std::memory_order_relaxed) + amount,
+                 std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] std::uint64_t Value() const noexcept {
+    return _value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::uint64_t> _value = 0;
+};
+
+/**
+ * @brief the latest value of a measurement, updated by one thread
+ */
+class Gauge {
+public:
+  void Set(double value) noexcept {
+    _value.store(value, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] double Value() const noexcept {
+    return _value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<double> _value = 0.0;
+};
+
+/**
+ * @brief named, non-owning view of metrics for export. Registered metrics
+ * must outlive the registry, or at least every call to WritePrometheus.
+ * Registration and export may happen on any thread
+ */
+class MetricsRegistry {
+public:
+  /** computed when exported; must be safe to call from any thread */
+  using Computed = std::function<double()>;
+
+  void Add(std::string name, std::string help, const Counter &counter);
+
+  void Add(std::string name, std::string help, const Gauge &gauge);
+
+  void Add(std::string name, std::string help, Computed gauge);
+
+  /**
+   * @brief exported in seconds, with the buckets of LATENCY_BOUNDS_US
+   */
+  void Add(std::string name, std::string help,
+           const LatencyHistogram &histogram);
+
+  /**
+   * @brief all metrics in the Prometheus text exposition format
+   */
+  void WritePrometheus(std::ostream &out) const;
+
+private:
+  constexpr static std::array<unsigned, 9> LATENCY_BOUNDS_US = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 20000};
+
+  struct Entry {
+    std::string name;
+    std::string help;
+    std::variant<const Counter *, const Gauge *, Computed,
+                 const LatencyHistogram *>
+      metric;
+  };
+
+  mutable std::mutex _mutex;
+  std::vector<Entry> _entries;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Metrics.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+
+/**
+ * @brief exports a MetricsRegistry in the Prometheus text format from a
+ * background thread, over a local Unix stream socket, to a file, or both.
+ *
+ * Each connection to the socket gets one snapshot and is closed. A client
+ * that sends an HTTP request first (e.g.
+ * `curl --unix-socket chip8-metrics.sock http://localhost/metrics`) gets an
+ * HTTP response; any other client gets the bare text.
+ *
+ * The file is rewritten every `interval` by writing a temporary file next to
+ * it and renaming it over the old one, so readers such as node_exporter's
+ * textfile collector never see a partial snapshot.
+ */
+class MetricsServer {
+public:
+  struct Options {
+    std::optional<std::filesystem::path> socketPath;
+    std::optional<std::filesystem::path> filePath;
+    std::chrono::milliseconds interval{1000};
+
+    /**
+     * @brief read `<prefix>_SOCKET`, `<prefix>_FILE` and
+     * `<prefix>_INTERVAL_MS`
+     * @throws std::invalid_argument on a malformed interval
+     */
+    static Options FromEnvironment(const std::string &prefix);
+
+    [[nodiscard]] bool Enabled() const { return socketPath || filePath; }
+  };
+
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer(MetricsServer &&) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+  MetricsServer &operator=(MetricsServer &&) = delete;
+
+  /**
+   * @param registry must outlive the server
+   * @throws std::runtime_error if the socket cannot be created
+   */
+  MetricsServer(const MetricsRegistry *registry, Options options);
+
+  ~MetricsServer();
+
+private:
+  void Serve();
+
+  void ServeClient(int client) const;
+
+  void WriteFile() const;
+
+  const MetricsRegistry *_registry;
+  Options _options;
+  int _listener = -1;
+  std::atomic<bool> _stopping = false;
+  std::thread _thread;
+};
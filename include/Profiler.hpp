@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief counts executed instructions per opcode class, per program counter
+ * and per call stack (as built from 2NNN / 00EE)
+ */
+class Profiler {
+public:
+  constexpr static bool ENABLED = true;
+
+  Profiler();
+
+  void OnInstruction(std::size_t programCounter, int instruction) {
+    ++_instructions;
+    // NOLINTBEGIN(*-array-index)
+    ++_opcodeCounts[ClassIndex(instruction)];
+    ++_pcCounts[programCounter & (ADDRESS_SPACE - 1)];
+    ++_nodes[_currentNode].cycles;
+    // NOLINTEND(*-array-index)
+  }
+
+  void OnCall(std::size_t target);
+
+  void OnReturn();
+
+  void Reset();
+
+  void WriteJson(std::ostream &out) const;
+
+  /**
+   * @brief one line per call stack, `frame;frame;frame cycles`, as consumed by
+   * flamegraph.pl and similar tools
+   */
+  void WriteFoldedStacks(std::ostream &out) const;
+
+private:
+  struct CallNode {
+    std::size_t parent;
+    std::size_t target;
+    std::uint64_t cycles;
+    std::vector<std::size_t> children;
+  };
+
+  /**
+   * @brief index of the opcode class: the first nibble, plus the bits that
+   * select the operation within the 0, 5, 8, E and F families
+   */
+  static constexpr std::size_t ClassIndex(int instruction) {
+    // NOLINTBEGIN(*-magic-numbers)
+    const auto family = static_cast<std::size_t>(instruction & 0xF000) >> 12;
+    std::size_t selector = 0;
+    switch (family) {
+    case 0x0:
+    case 0xE:
+    case 0xF:
+      selector = static_cast<std::size_t>(instruction & 0x00FF);
+      break;
+    case 0x5:
+    case 0x8:
+      selector = static_cast<std::size_t>(instruction & 0x000F);
+      break;
+    default:
+      break;
+    }
+    return family << 8 | selector;
+    // NOLINTEND(*-magic-numbers)
+  }
+
+  static std::string ClassName(std::size_t classIndex);
+
+  std::string StackName(std::size_t node) const;
+
+  constexpr static std::size_t NUM_CLASSES = 16 * 256;
+  constexpr static std::size_t ADDRESS_SPACE = 65536;
+  constexpr static std::size_t ROOT = 0;
+
+  std::uint64_t _instructions = 0;
+  std::array<std::uint64_t, NUM_CLASSES> _opcodeCounts{};
+  /** on the heap: 512 KB once the XO-CHIP address space is covered */
+  std::vector<std::uint64_t> _pcCounts;
+  std::vector<CallNode> _nodes;
+  std::size_t _currentNode = ROOT;
+};
+
+/**
+ * @brief stands in for Profiler when profiling is compiled out; every hook is
+ * an empty inline function so the calls disappear entirely
+ */
+class NullProfiler {
+public:
+  constexpr static bool ENABLED = false;
+
+  void OnInstruction(std::size_t /*programCounter*/, int /*instruction*/) {}
+  void OnCall(std::size_t /*target*/) {}
+  void OnReturn() {}
+  void Reset() {}
+  void WriteJson(std::ostream &out) const { out << "{\"enabled\":false}\n"; }
+  void WriteFoldedStacks(std::ostream & /*out*/) const {}
+};
+
+#ifdef CHIP8_ENABLE_PROFILER
+using ActiveProfiler = Profiler;
+#else
+using ActiveProfiler = NullProfiler;
+#endif
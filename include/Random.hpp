@@ -1,16 +1,78 @@
 #pragma once
 
-#include <random>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief counter-based generator (Widynski's Squares): draw n of a stream is
+ * a pure function of the stream's key and n. Streams are keyed by a global
+ * seed and an instance id, so a machine's random numbers do not depend on
+ * which thread or batch lane runs it, and skipping ahead is O(1)
+ */
 class RandomNumberGenerator {
 public:
   /**
-   * @brief construct a random number generator with a uniform distribution on
-   * [min, max]
+   * @brief stream `instance` of `seed`, positioned at its first draw
+   */
+  RandomNumberGenerator(std::uint64_t seed, std::uint64_t instance);
+
+  /**
+   * @brief the next draw's top byte, uniform on [0, 255]
+   */
+  std::uint8_t Generate() {
+    // NOLINTNEXTLINE(*-magic-numbers)
+    return static_cast<std::uint8_t>(Squares32(_counter++, _key) >> 24);
+  }
+
+  /**
+   * @brief 32 bits of draw `counter` of the stream keyed `key`
+   */
+  static constexpr std::uint32_t Squares32(std::uint64_t counter,
+                                           std::uint64_t key) {
+    // NOLINTBEGIN(*-magic-numbers)
+    std::uint64_t x = counter * key;
+    const std::uint64_t y = x;
+    const std::uint64_t z = y + key;
+    x = x * x + y;
+    x = x >> 32 | x << 32;
+    x = x * x + z;
+    x = x >> 32 | x << 32;
+    x = x * x + y;
+    x = x >> 32 | x << 32;
+    return static_cast<std::uint32_t>((x * x + z) >> 32);
+    // NOLINTEND(*-magic-numbers)
+  }
+
+  /**
+   * @brief one draw per lane of a batch: `out[i]` is draw `counters[i]` of
+   * the stream keyed `keys[i]`. Lanes are independent, so the loop
+   * vectorizes; all three spans must be the same length
    */
-  RandomNumberGenerator(int min, int max, int seed);
-  int Generate();
+  static void GenerateBatch(std::span<const std::uint64_t> keys,
+                            std::span<const std::uint64_t> counters,
+                            std::span<std::uint32_t> out);
+
+  [[nodiscard]] std::uint64_t Key() const { return _key; }
+
+  /**
+   * @brief index of the next draw
+   */
+  [[nodiscard]] std::uint64_t Position() const { return _counter; }
+
+  /**
+   * @brief make draw `position` the next one
+   */
+  void Seek(std::uint64_t position) { _counter = position; }
+
+  /** size of the snapshot written by Save: the key and the position */
+  constexpr static std::size_t STATE_BYTES = 16;
+
+  void Save(std::span<std::uint8_t, STATE_BYTES> out) const;
+
+  void Load(std::span<const std::uint8_t, STATE_BYTES> in);
 
 private:
-  std::mt19937 _rng;
-  std::uniform_int_distribution<int> _dist;
-};
\ No newline at end of file
+  std::uint64_t _key;
+  std::uint64_t _counter = 0;
+};
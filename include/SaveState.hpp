@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Random.hpp"
+#include "Screen.hpp"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <type_traits>
+
+static_assert(std::endian::native == std::endian::little,
+              "save states are stored little-endian");
+
+/**
+ * @brief fixed header of a save state file
+ */
+struct SaveStateHeader {
+  std::uint32_t magic;
+  std::uint16_t version;
+  std::uint16_t headerBytes;
+  std::uint32_t payloadBytes;
+  std::uint32_t reserved;
+  /** FNV-1a over the payload, one 64 bit word at a time */
+  std::uint64_t checksum;
+};
+
+/**
+ * @brief full machine state. Large blocks come first so that every field is
+ * naturally aligned and there is no implicit padding
+ */
+struct SaveStatePayload {
+  constexpr static std::size_t MEMORY_BYTES = 65536;
+  constexpr static std::size_t STACK_SIZE = 16;
+  constexpr static std::size_t NUM_REGISTERS = 16;
+  constexpr static std::size_t NUM_FLAGS = 16;
+
+  std::array<std::uint8_t, MEMORY_BYTES> memory;
+  std::array<std::uint8_t, Screen::FRAMEBUFFER_BYTES> framebuffer;
+  std::array<std::uint8_t, RandomNumberGenerator::STATE_BYTES> rng;
+  std::array<std::uint16_t, STACK_SIZE> stack;
+  std::array<std::uint8_t, NUM_REGISTERS> registers;
+  /** SUPER-CHIP RPL flags */
+  std::array<std::uint8_t, NUM_FLAGS> flags;
+  std::uint16_t programCounter;
+  std::uint16_t index;
+  std::uint8_t stackPointer;
+  std::uint8_t delayTimer;
+  std::uint8_t soundTimer;
+  /** nonzero in SUPER-CHIP 128x64 mode */
+  std::uint8_t highResolution;
+  /** bit flags of the active quirk profile; the interpreter has no quirks yet */
+  std::uint32_t quirks;
+  /** XO-CHIP planes selected by FN01 */
+  std::uint8_t planes;
+  std::array<std::uint8_t, 3> reserved1;
+};
+
+/**
+ * @brief a header followed by the payload. The struct is the file format: a
+ * save state file is exactly these bytes, so it can be written with one call
+ * and read back (or mmapped) without any parsing
+ */
+struct SaveState {
+  constexpr static std::uint32_t MAGIC = 0x38504843; // "CHP8"
+  constexpr static std::uint16_t VERSION = 4;
+
+  SaveStateHeader header;
+  SaveStatePayload payload;
+
+  /**
+   * @brief fill in the header for the current payload
+   */
+  void Seal();
+
+  /**
+   * @throws std::runtime_error if the header or checksum do not match
+   */
+  void Validate() const;
+
+  [[nodiscard]] std::uint64_t Checksum() const;
+
+  void WriteToFile(const std::filesystem::path &path) const;
+
+  /**
+   * @brief read and validate a save state file
+   */
+  void ReadFromFile(const std::filesystem::path &path);
+
+  /**
+   * @brief view a buffer holding a save state (e.g. an mmapped file) in place
+   * @throws std::runtime_error if the buffer is not a valid save state
+   */
+  static const SaveState &FromBytes(std::span<const std::byte> bytes);
+};
+
+static_assert(std::is_trivially_copyable_v<SaveState>);
+static_assert(std::has_unique_object_representations_v<SaveStateHeader>);
+static_assert(std::has_unique_object_representations_v<SaveStatePayload>);
+static_assert(sizeof(SaveStatePayload) % sizeof(std::uint64_t) == 0);
+static_assert(sizeof(SaveState) ==
+              sizeof(SaveStateHeader) + sizeof(SaveStatePayload));
@@ -1,47 +1,222 @@
 #ifndef SCREEN_HPP
 #define SCREEN_HPP
 
+#include "Metrics.hpp"
 #include "Types.hpp"
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <span>
 #include <vector>
-class Screen {
-  using Pixel = bool;
-  using UpdateCallback = std::function<void(const std::span<Pixel>)>;
 
+/**
+ * @brief the display: 64x32 pixels, or 128x64 in SUPER-CHIP high resolution,
+ * with up to four XO-CHIP bit planes. Rows are bit-packed so that drawing and
+ * scrolling work on whole words; a pixel's colour is the index formed by its
+ * bit in each plane, plane 0 being the least significant
+ */
+class Screen {
 public:
+  /**
+   * @brief one row of pixels: pixel x is bit x % 64 of word x / 64. Bits at
+   * or beyond the current width are always clear
+   */
+  using Row = std::array<std::uint64_t, 2>;
+
+  using UpdateCallback = std::function<void(const Screen &)>;
+
+  /**
+   * @brief clear the selected planes
+   */
   void Clear();
 
   void Update();
 
   /**
-   * @brief draw sprite to position `x` mod WIDTH, `y` mod HEIGHT. Sprites that
-   * exceed the screen's width or height are cut off at the edge (i.e. sprites
-   * do not wrap)
+   * @brief XO-CHIP FN01: later draws, clears and scrolls apply to the planes
+   * whose bits are set in `mask`
+   */
+  void SelectPlanes(unsigned int mask);
+
+  [[nodiscard]] unsigned int SelectedPlanes() const { return _selected; }
+
+  /**
+   * @brief sprite data a draw consumes is this many sprites, one per selected
+   * plane, lowest plane first
+   */
+  [[nodiscard]] std::size_t SelectedPlaneCount() const;
+
+  /**
+   * @brief draw an 8 pixel wide sprite to position `x` mod Width(), `y` mod
+   * Height() in each selected plane. `sprite` holds SelectedPlaneCount()
+   * sprites of equal height back to back. Sprites that exceed the screen's
+   * width or height are cut off at the edge (i.e. sprites do not wrap)
    * @return true iff any pixels were erased, i.e. a collision occurred
    */
-  bool Draw(Byte x, Byte y, const std::span<Byte> sprite);
+  [[nodiscard]] bool Draw(Byte x, Byte y, std::span<const std::uint8_t> sprite);
+
+  /**
+   * @brief draw a SUPER-CHIP 16x16 sprite, two bytes per row, in each
+   * selected plane, laid out and clipped like Draw
+   * @return true iff any pixels were erased
+   */
+  [[nodiscard]] bool DrawLarge(Byte x, Byte y, std::span<const std::uint8_t> sprite);
+
+  /**
+   * @brief move the picture down `rows` rows, clearing the rows above it.
+   * Scroll distances are in pixels of the current resolution
+   */
+  void ScrollDown(std::size_t rows);
+
+  /**
+   * @brief XO-CHIP 00DN: move the picture up `rows` rows
+   */
+  void ScrollUp(std::size_t rows);
+
+  /**
+   * @brief move the picture SCROLL_PIXELS to the left
+   */
+  void ScrollLeft();
+
+  /**
+   * @brief move the picture SCROLL_PIXELS to the right
+   */
+  void ScrollRight();
+
+  /**
+   * @brief switch between 64x32 and 128x64; clears every plane
+   */
+  void SetHighResolution(bool enabled);
+
+  [[nodiscard]] bool HighResolution() const { return _highResolution; }
+
+  [[nodiscard]] std::size_t Width() const {
+    return _highResolution ? HIRES_WIDTH : WIDTH;
+  }
+
+  [[nodiscard]] std::size_t Height() const {
+    return _highResolution ? HIRES_HEIGHT : HEIGHT;
+  }
+
+  /**
+   * @brief palette index of a pixel, 0 if it is clear in every plane
+   */
+  [[nodiscard]] std::uint8_t ColorAt(std::size_t x, std::size_t y) const;
+
+  /**
+   * @brief one plane of the framebuffer, Height() rows
+   */
+  [[nodiscard]] std::span<const Row> Rows(std::size_t plane = 0) const {
+    return std::span(_planes.at(plane)).first(Height());
+  }
 
   void Display();
 
   void RegisterUpdateCallback(UpdateCallback callback);
 
+  /**
+   * @brief framebuffer changes so far; a viewer that polls can compare it
+   * with the value it last drew instead of registering a callback
+   */
+  [[nodiscard]] std::uint64_t UpdateCount() const { return _updates.Value(); }
+
+  /**
+   * @brief hash of every plane, the resolution and the selected planes. Only
+   * rows changed since the last call are rehashed; equal screens give equal
+   * hashes
+   */
+  std::uint64_t Hash();
+
+  /**
+   * @brief export sprites drawn and framebuffer updates; the screen must
+   * outlive the registry
+   */
+  void RegisterMetrics(MetricsRegistry &registry) const;
+
   constexpr static std::size_t WIDTH = 64;
 
   constexpr static std::size_t HEIGHT = 32;
 
+  constexpr static std::size_t HIRES_WIDTH = 128;
+
+  constexpr static std::size_t HIRES_HEIGHT = 64;
+
+  /** one bit plane: every row of the high resolution framebuffer */
+  using Plane = std::array<Row, HIRES_HEIGHT>;
+
+  constexpr static std::size_t NUM_PLANES = 4;
+
+  /** colours a pixel can take: one per combination of planes */
+  constexpr static std::size_t NUM_COLORS = 1U << NUM_PLANES;
+
+  /** horizontal distance of 00FB and 00FC */
+  constexpr static std::size_t SCROLL_PIXELS = 4;
+
+  /**
+   * @brief every row of every plane at high resolution, little-endian words
+   */
+  constexpr static std::size_t FRAMEBUFFER_BYTES =
+    NUM_PLANES * HIRES_HEIGHT * sizeof(Row);
+
+  void Save(std::span<std::uint8_t, FRAMEBUFFER_BYTES> out) const;
+
+  /**
+   * @brief restore a framebuffer written by Save and notify listeners
+   */
+  void Load(std::span<const std::uint8_t, FRAMEBUFFER_BYTES> in,
+            bool highResolution, unsigned int selectedPlanes);
+
 private:
+  static_assert(HIRES_WIDTH == sizeof(Row) * 8);
+
   static void ClearStdout();
 
-  Pixel &PixelAt(std::size_t x, std::size_t y);
+  /**
+   * @brief XOR rows of up to 64 pixels, leftmost pixel in bit 0, into the
+   * selected planes with the leftmost at column `x`. `sprite` holds
+   * `rowsPerPlane` rows for each selected plane in turn
+   */
+  bool DrawRows(Byte x, Byte y, std::span<const std::uint64_t> sprite,
+                std::size_t rowsPerPlane);
+
+  /**
+   * @brief call `apply` with each selected plane's visible rows
+   */
+  template <typename Function> void ForEachSelected(Function apply) {
+    for (std::size_t plane = 0; plane < NUM_PLANES; ++plane) {
+      if ((_selected >> plane & 1U) != 0) {
+        // NOLINTNEXTLINE(*-array-index)
+        apply(std::span(_planes[plane]).first(Height()));
+      }
+    }
+  }
+
+  /** bits of a row that lie within the current width */
+  [[nodiscard]] Row RowMask() const;
 
   void NotifyUpdate();
 
-  std::array<Pixel, WIDTH * HEIGHT> _pixels = {};
+  constexpr static std::uint64_t ALL_ROWS = ~std::uint64_t{0};
+
+  static_assert(HIRES_HEIGHT == sizeof(ALL_ROWS) * 8);
+
+  std::array<Plane, NUM_PLANES> _planes = {};
+
+  /** one bit per row, in any plane, whose cached hash is out of date */
+  std::uint64_t _staleRows = ALL_ROWS;
+  std::array<std::uint64_t, HIRES_HEIGHT> _rowHashes{};
+  /** XOR of _rowHashes */
+  std::uint64_t _rowsHash = 0;
+
+  unsigned int _selected = 1;
+
+  bool _highResolution = false;
 
   std::vector<UpdateCallback> _updateCallbacks;
+
+  Counter _draws;
+  Counter _updates;
 };
 
-#endif
\ No newline at end of file
+#endif
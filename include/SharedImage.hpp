@@ -0,0 +1,62 @@
+#pragma once
+
+#include "StateHash.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+
+/**
+ * @brief process-wide, deduplicated read-only memory images. Every machine
+ * that loads the same ROM gets the same image, so the font and program bytes
+ * exist once however many instances are running. Images are freed when the
+ * last machine mapping them goes away
+ */
+template <std::size_t Size> class SharedImages {
+public:
+  using Storage = std::array<std::uint8_t, Size>;
+
+  /**
+   * @brief the shared image with the same contents as `image`, creating it if
+   * no live image matches
+   */
+  static std::shared_ptr<const Storage> Intern(const Storage &image) {
+    const auto hash = Hash(image);
+    const std::scoped_lock lock(_mutex);
+    auto &slot = _images[hash];
+    if (auto existing = slot.lock(); existing && *existing == image) {
+      return existing;
+    }
+    // on the (unlikely) hash collision the newer image takes the slot and
+    // the older one simply stops being shared with new machines
+    auto created = std::make_shared<const Storage>(image);
+    slot = created;
+    Prune();
+    return created;
+  }
+
+  static std::uint64_t Hash(std::span<const std::uint8_t> image) {
+    StateHasher hasher;
+    hasher.AddBytes(std::as_bytes(image));
+    return hasher.Value();
+  }
+
+private:
+  /** drop expired slots once the table has doubled since the last prune */
+  static void Prune() {
+    if (_images.size() < _pruneAt) {
+      return;
+    }
+    std::erase_if(_images,
+                  [](const auto &slot) { return slot.second.expired(); });
+    _pruneAt = 2 * _images.size() + 1;
+  }
+
+  inline static std::mutex _mutex;
+  inline static std::unordered_map<std::uint64_t, std::weak_ptr<const Storage>>
+    _images;
+  inline static std::size_t _pruneAt = 1;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+/**
+ * @brief FNV-1a over 64-bit words, the one FNV implementation behind save
+ * state checksums, machine state hashes, ROM and framebuffer hashes. Each step
+ * is a bijection of the running hash, so inputs that differ in a single word
+ * never collide. Adding one byte per step gives classic byte-wise FNV-1a
+ */
+class StateHasher {
+public:
+  constexpr StateHasher() = default;
+
+  /**
+   * @brief start from a basis perturbed by `seed`, e.g. the position of the
+   * hashed block, so that equal blocks in different places hash differently
+   */
+  constexpr explicit StateHasher(std::uint64_t seed) : _hash(OFFSET_BASIS) {
+    Add(seed);
+  }
+
+  constexpr void Add(std::uint64_t word) {
+    _hash ^= word;
+    _hash *= PRIME;
+  }
+
+  /**
+   * @brief add `bytes` a word at a time; a short last word is zero-padded
+   */
+  void AddBytes(std::span<const std::byte> bytes) {
+    constexpr static std::size_t WORD_BYTES = sizeof(std::uint64_t);
+    // fixed-size copies compile to plain loads
+    std::size_t offset = 0;
+    for (; offset + WORD_BYTES <= bytes.size(); offset += WORD_BYTES) {
+      std::uint64_t word = 0;
+      std::memcpy(&word, bytes.subspan(offset).data(), WORD_BYTES);
+      Add(word);
+    }
+    if (offset < bytes.size()) {
+      std::uint64_t word = 0;
+      std::memcpy(&word, bytes.subspan(offset).data(), bytes.size() - offset);
+      Add(word);
+    }
+  }
+
+  [[nodiscard]] constexpr std::uint64_t Value() const { return _hash; }
+
+private:
+  constexpr static std::uint64_t OFFSET_BASIS = 0xCBF29CE484222325;
+  constexpr static std::uint64_t PRIME = 0x100000001B3;
+
+  std::uint64_t _hash = OFFSET_BASIS;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "Metrics.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// The emulator runs three threads:
+//  - emulation: Chip8::Run, paced to 60 frames/s by a FramePacer. Optionally
+//    pinned to a CPU and run under SCHED_FIFO (see ThreadOptions)
+//  - render: the main thread, running SDL's event loop (SDL requires it)
+//  - audio: SDL's audio callback thread
+// They share only the keyboard, the frame queue and a few flags, each kept
+// on its own cache line.
+
+/**
+ * @brief assumed cache line size. std::hardware_destructive_interference_size
+ * is not ABI-stable across compiler flags, so it is not used in headers
+ */
+constexpr std::size_t CACHE_LINE_BYTES = 64;
+
+/**
+ * @brief a value alone on its cache line, so that one thread writing it does
+ * not invalidate data another thread is reading
+ */
+template <typename T> struct alignas(CACHE_LINE_BYTES) CacheLinePadded {
+  T value{};
+};
+
+/**
+ * @brief scheduling for one thread
+ */
+struct ThreadOptions {
+  /** CPU to pin the thread to; unpinned if empty */
+  std::optional<int> cpu;
+  /** SCHED_FIFO priority, 1-99; normal scheduling if empty */
+  std::optional<int> fifoPriority;
+
+  /**
+   * @brief read `<prefix>_CPU` and `<prefix>_FIFO_PRIORITY`
+   * @throws std::invalid_argument on a malformed value
+   */
+  static ThreadOptions FromEnvironment(std::string_view prefix);
+};
+
+/**
+ * @brief apply `options` to the calling thread
+ * @throws std::system_error if the OS refuses, e.g. SCHED_FIFO without
+ * CAP_SYS_NICE
+ */
+void ApplyThreadOptions(const ThreadOptions &options);
+
+/**
+ * @brief CPU time consumed by the calling thread
+ */
+std::chrono::nanoseconds ThreadCpuTime();
+
+/**
+ * @brief fixed-resolution histogram of durations: 10us buckets up to 20ms,
+ * anything longer in the last bucket. Recorded by one thread; see Metrics.hpp
+ * for why it may be read from others
+ */
+class LatencyHistogram {
+public:
+  using Duration = std::chrono::nanoseconds;
+
+  void Record(Duration sample);
+
+  [[nodiscard]] std::uint64_t Count() const {
+    return _count.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] Duration Total() const {
+    return Duration{_total.load(std::memory_order_relaxed)};
+  }
+
+  [[nodiscard]] Duration Mean() const;
+
+  /**
+   * @brief upper bound of the bucket holding the given quantile (0-1)
+   */
+  [[nodiscard]] Duration Quantile(double quantile) const;
+
+  /**
+   * @brief number of samples in buckets that end at or below `bound`
+   */
+  [[nodiscard]] std::uint64_t CountAtMost(Duration bound) const;
+
+  [[nodiscard]] Duration Max() const {
+    return Duration{_max.load(std::memory_order_relaxed)};
+  }
+
+private:
+  constexpr static Duration BUCKET_WIDTH = std::chrono::microseconds{10};
+  constexpr static std::size_t NUM_BUCKETS = 2000;
+
+  std::array<std::atomic<std::uint64_t>, NUM_BUCKETS> _buckets{};
+  std::atomic<std::uint64_t> _count = 0;
+  std::atomic<Duration::rep> _total = 0;
+  std::atomic<Duration::rep> _max = 0;
+};
+
+/**
+ * @brief sleeps until absolute deadlines one period apart, so that time spent
+ * working does not accumulate as drift. Records how late each wake-up was
+ * (jitter) and how many deadlines had already passed when Wait was called
+ */
+class FramePacer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit FramePacer(Clock::duration period);
+
+  /**
+   * @brief sleep until the next deadline. If more than MAX_LAG periods
+   * behind, the schedule restarts from now rather than running the missed
+   * frames back to back
+   */
+  void Wait();
+
+  [[nodiscard]] const LatencyHistogram &Lateness() const { return _lateness; }
+
+  [[nodiscard]] std::uint64_t Missed() const { return _missed.Value(); }
+
+  /**
+   * @brief export lateness and missed deadlines as `<prefix>_...`; the pacer
+   * must outlive the registry
+   */
+  void RegisterMetrics(MetricsRegistry &registry,
+                       const std::string &prefix) const;
+
+  /**
+   * @brief one line: frames, missed deadlines, wake-up lateness and the
+   * CPU share of the thread that called Wait
+   */
+  void WriteSummary(std::ostream &out, std::string_view name) const;
+
+private:
+  constexpr static int MAX_LAG = 4;
+
+  Clock::duration _period;
+  Clock::time_point _start;
+  Clock::time_point _deadline;
+  std::chrono::nanoseconds _startCpu;
+  std::chrono::nanoseconds _lastCpu;
+  Clock::time_point _lastWake;
+  LatencyHistogram _lateness;
+  Counter _missed;
+};
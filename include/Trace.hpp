@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief one executed instruction. X is recoverable from the instruction, so
+ * the register delta is just the values of VX and VF after execution
+ */
+struct TraceEntry {
+  std::uint16_t programCounter;
+  std::uint16_t instruction;
+  std::uint16_t index;
+  std::uint8_t vx;
+  std::uint8_t vf;
+};
+
+static_assert(sizeof(TraceEntry) == 8);
+
+/**
+ * @brief fixed-size ring of the most recently executed instructions
+ */
+template <std::size_t Depth> class TraceRing {
+  static_assert(std::has_single_bit(Depth), "depth must be a power of two");
+
+public:
+  /**
+   * @brief start a new entry; the caller fills in the register values once
+   * the instruction has executed
+   */
+  TraceEntry &Begin(std::size_t programCounter, int instruction,
+                    std::size_t index) {
+    // NOLINTNEXTLINE(*-array-index)
+    auto &entry = _entries[_position++ & (Depth - 1)];
+    entry = {static_cast<std::uint16_t>(programCounter),
+             static_cast<std::uint16_t>(instruction),
+             static_cast<std::uint16_t>(index), 0, 0};
+    return entry;
+  }
+
+  /**
+   * @brief entries from oldest to newest
+   */
+  [[nodiscard]] std::vector<TraceEntry> Entries() const {
+    const auto count = _position < Depth ? _position : Depth;
+    std::vector<TraceEntry> entries;
+    entries.reserve(count);
+    for (auto i = _position - count; i < _position; ++i) {
+      // NOLINTNEXTLINE(*-array-index)
+      entries.push_back(_entries[i & (Depth - 1)]);
+    }
+    return entries;
+  }
+
+  void Clear() { _position = 0; }
+
+private:
+  std::array<TraceEntry, Depth> _entries{};
+  std::size_t _position = 0;
+};
+
+/**
+ * @brief write trace entries as human readable lines
+ */
+void WriteTrace(std::ostream &out, const std::vector<TraceEntry> &entries);
+
+/**
+ * @brief streams every executed instruction to a binary file: a 16 byte
+ * header ("C8TR", version, entry size) followed by raw little-endian entries
+ */
+class TraceWriter {
+public:
+  TraceWriter(const TraceWriter &) = delete;
+  TraceWriter(TraceWriter &&) = delete;
+  TraceWriter &operator=(const TraceWriter &) = delete;
+  TraceWriter &operator=(TraceWriter &&) = delete;
+
+  explicit TraceWriter(const std::filesystem::path &path);
+
+  void Write(const TraceEntry &entry) {
+    _buffer.push_back(entry);
+    if (_buffer.size() == BUFFER_ENTRIES) {
+      Flush();
+    }
+  }
+
+  void Flush();
+
+  ~TraceWriter();
+
+private:
+  constexpr static std::size_t BUFFER_ENTRIES = 4096;
+  std::ofstream _file;
+  std::vector<TraceEntry> _buffer;
+};
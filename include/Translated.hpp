@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Interpreter.hpp"
+#include "InterpreterExecute.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief the interface between code generated by chip8_translate and a Chip8.
+ * Execute inlines the interpreter's own ExecuteInstruction, so with a
+ * constant instruction the compiler folds the dispatch and translated code
+ * has exactly the interpreter's semantics
+ */
+class Chip8::Native {
+public:
+  Native(Chip8 &chip, std::span<const std::uint8_t> codeMap)
+      : _chip(chip), _codeMap(codeMap) {}
+
+  [[gnu::always_inline]] void Execute(int instruction) {
+    _chip.ExecuteInstruction(instruction);
+  }
+
+  void SetProgramCounter(std::size_t address) {
+    _chip._programCounter = address;
+  }
+
+  [[nodiscard]] std::size_t ProgramCounter() const {
+    return _chip._programCounter;
+  }
+
+  /**
+   * @brief whether any translated instruction has been overwritten. Once
+   * true, stays true
+   */
+  bool CodeModified() {
+    const auto [first, last] = _chip._memory.WriteRange();
+    _chip._memory.ClearWriteRange();
+    for (auto address = first;
+         !_modified && address < last && address < _codeMap.size();
+         ++address) {
+      // NOLINTNEXTLINE(*-array-index)
+      _modified = _codeMap[address] != 0;
+    }
+    return _modified;
+  }
+
+private:
+  Chip8 &_chip;
+  std::span<const std::uint8_t> _codeMap;
+  bool _modified = false;
+};
+
+/**
+ * @brief a ROM compiled ahead of time. A block runs straight-line code
+ * starting at its address, executes at most `budget` instructions, leaves
+ * the program counter at the next instruction and returns how many it ran
+ */
+struct TranslatedProgram {
+  using Block = std::size_t (*)(Chip8::Native &machine, std::size_t budget);
+
+  /** FNV-1a of the ROM image the blocks were generated from */
+  std::uint64_t romHash;
+  std::span<const std::uint8_t> rom;
+  /** indexed by address; nullptr where there is no block */
+  std::span<const Block> blocks;
+  /** nonzero for every byte that belongs to a translated instruction */
+  std::span<const std::uint8_t> codeMap;
+
+  static std::uint64_t HashRom(std::span<const std::uint8_t> rom);
+};
+
+/**
+ * @brief runs a Chip8 through translated blocks, falling back to the
+ * interpreter where there is no block (e.g. after BNNN) and permanently once
+ * the program overwrites its own code. Profiling, tracing and debugger hooks
+ * only see the interpreted instructions
+ */
+class TranslatedRunner {
+public:
+  /**
+   * @throws std::invalid_argument if the loaded program is not the one the
+   * translation was generated from
+   */
+  TranslatedRunner(Chip8 *chip, const TranslatedProgram &program);
+
+  void Step(std::size_t count);
+
+  void RunFrame();
+
+  [[nodiscard]] bool UsingTranslation() const { return _valid; }
+
+private:
+  Chip8 *_chip;
+  const TranslatedProgram &_program;
+  Chip8::Native _native;
+  bool _valid = true;
+};
@@ -1,50 +1,178 @@
 #pragma once
 #include "AudioManager.hpp"
 #include "Keyboard.hpp"
+#include "Metrics.hpp"
 #include "SafeQueue.hpp"
+#include "Screen.hpp"
+#include "Threading.hpp"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_audio.h>
 #include <SDL2/SDL_keycode.h>
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_stdinc.h>
 #include <SDL2/SDL_surface.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
 
 class SdlManager {
-  using Frame = std::vector<bool>;
-
 public:
+  /**
+   * @brief a copy of every plane of the framebuffer; fixed size, so that
+   * switching resolution never reallocates anything on the frame path
+   */
+  struct Frame {
+    std::size_t width = Screen::WIDTH;
+    std::size_t height = Screen::HEIGHT;
+    std::array<Screen::Plane, Screen::NUM_PLANES> planes{};
+
+    static Frame Capture(const Screen &screen);
+  };
+
   SdlManager(const SdlManager &) = delete;
   SdlManager(SdlManager &&) = delete;
   SdlManager &operator=(const SdlManager &) = delete;
   SdlManager &operator=(SdlManager &&) = delete;
 
-  SdlManager(int widthPixels, int heightPixels, Keyboard *keyboard);
+  /**
+   * @brief start SDL video and create the window. Audio starts the first
+   * time `*tone` is seen set, so silent programs never pay for it
+   * @param widthPixels, heightPixels the largest frame; the streaming texture
+   * is created once at this size and smaller frames use part of it
+   * @param tone flag that turns the audio tone on; must outlive the manager
+   */
+  SdlManager(int widthPixels, int heightPixels, Keyboard *keyboard,
+             const std::atomic<bool> *tone);
 
+  /**
+   * @brief the event loop: blocks until an event, a new frame or the next
+   * present deadline, and presents at most once per display refresh
+   */
   void Run();
 
+  /**
+   * @brief hand a frame to the render thread; callable from any thread
+   */
   void QueueFrame(Frame frame);
 
+  /**
+   * @brief `callback` runs on the render thread right after the first frame
+   * is presented
+   */
+  void RegisterFirstPresentCallback(std::function<void()> callback);
+
+  /**
+   * @brief one line: frames presented and dropped, missed deadlines and
+   * queue-to-present latency
+   */
+  void WriteSummary(std::ostream &out) const;
+
+  /**
+   * @brief export the frame path (presents, drops, queue depth, latency) and
+   * audio metrics; the manager must outlive the registry
+   */
+  void RegisterMetrics(MetricsRegistry &registry) const;
+
+  /**
+   * @brief texture colour of each palette index. 0 and 1 are the CHIP-8
+   * background and foreground, 2 and 3 the usual XO-CHIP second plane and
+   * blend
+   */
+  constexpr static std::array<Uint32, Screen::NUM_COLORS> PALETTE{
+    0x000000, 0x000FFF, 0xFF6600, 0x662200, 0x00AA00, 0x00FFAA,
+    0xAAFF00, 0x558800, 0xAA00AA, 0xFF55FF, 0xFFAA55, 0x884400,
+    0x555555, 0x55AAFF, 0xFFFF55, 0xFFFFFF,
+  };
+
+  /**
+   * @brief the CHIP-8 key (0-F) bound to `key`, if any
+   */
+  static std::optional<std::size_t> KeyIndex(SDL_Keycode key);
+
+  /**
+   * @brief convert a frame to texture pixels, `frame.width` per row, looking
+   * each pixel's plane bits up in the palette; `pixels` must hold at least
+   * `frame.width * frame.height` elements
+   */
+  static void ConvertFrame(const Frame &frame, std::span<Uint32> pixels);
+
   ~SdlManager();
 
 private:
+  using Clock = std::chrono::steady_clock;
+
+  struct QueuedFrame {
+    Frame frame;
+    Clock::time_point queued;
+  };
+
   // frame must be valid
   void RenderFrame(const Frame &toRender);
 
   void TryRenderFrame();
 
+  /**
+   * @return whether the event asks to quit
+   */
+  bool HandleEvent(const SDL_Event &event);
+
+  /**
+   * @brief how long the event loop may block, in milliseconds
+   */
+  [[nodiscard]] int WaitTimeout() const;
+
+  void RecordPresent(Clock::time_point started, Clock::time_point finished);
+
   void SetKeyStatus(SDL_Keycode key, bool status);
 
+  /**
+   * @brief open the audio device once the tone first sounds
+   */
+  void StartAudioIfNeeded();
+
   SDL_Window *_window = nullptr;
   SDL_Surface *_surface = nullptr;
   SDL_Renderer *_renderer = nullptr;
   SDL_Texture *_texture = nullptr;
   std::unique_ptr<AudioManager> _audio = nullptr;
+  const std::atomic<bool> *_tone;
+  /** set if the device failed to open, so that it is not retried */
+  bool _audioFailed = false;
+  std::function<void()> _onFirstPresent;
   std::size_t _screenWidth;
   std::size_t _screenHeight;
   unsigned int _width;
   unsigned int _height;
   Keyboard *_keyboard;
-  constexpr static int PIXEL_RATIO = 10;
-  SafeQueue<Frame> _frameBuffer;
+  /** window pixels per high resolution pixel */
+  constexpr static int PIXEL_RATIO = 5;
+  SafeQueue<QueuedFrame> _frameBuffer;
   std::vector<Uint32> _pixels;
+
+  /** SDL user event that wakes the event loop when a frame is queued */
+  Uint32 _frameReadyEvent;
+  /** set by QueueFrame, cleared by the render thread */
+  CacheLinePadded<std::atomic<bool>> _wakePending;
+
+  /** newest frame not yet presented */
+  std::optional<QueuedFrame> _pendingFrame;
+  /** estimated from the display mode, then from measured present intervals */
+  Clock::duration _refreshPeriod;
+  /** moving average of the time from starting a render to presenting it */
+  Clock::duration _renderCost{};
+  Clock::time_point _lastPresent;
+  Clock::time_point _nextPresent;
+  LatencyHistogram _latency;
+  Counter _dropped;
+  Counter _missed;
+  Counter _dequeued;
+  Gauge _refreshSeconds;
+  /** the only metric QueueFrame's thread writes */
+  CacheLinePadded<Counter> _queued;
 };
\ No newline at end of file
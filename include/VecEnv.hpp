@@ -0,0 +1,197 @@
+#pragma once
+
+#include "Chip8Core.hpp"
+#include "SaveState.hpp"
+#include "Screen.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A vectorized environment: one server process hosts N headless machines in
+// a POSIX shared-memory segment that training processes map directly.
+//
+// Protocol, per step:
+//  1. the client writes each slot's action (and optionally reset)
+//  2. the client increments VecEnvHeader::stepRequest and wakes it (futex)
+//  3. server workers each step their share of the slots, write observations,
+//     rewards and done flags in place, and the last one to finish sets
+//     stepDone = stepRequest and wakes it
+//  4. the client, waiting on stepDone, reads the slots in place
+// Observations are never copied out of the segment.
+
+/**
+ * @brief a scalar read from a machine after each step: a byte of memory or a
+ * V register. Parsed from "mem:<addr>" or "reg:<x>" (hex)
+ */
+struct VecEnvProbe {
+  enum class Source : std::uint8_t { MEMORY, REGISTER };
+
+  Source source;
+  std::size_t location;
+
+  /**
+   * @throws std::invalid_argument on a malformed spec
+   */
+  static VecEnvProbe Parse(std::string_view spec);
+
+  [[nodiscard]] std::uint8_t Read(const Chip8Core &core) const;
+};
+
+struct VecEnvConfig {
+  std::size_t numEnvs = 1;
+  std::size_t workers = 1;
+  std::size_t framesPerStep = 1;
+  /** reward is the change in this value over the step; zero if unset */
+  std::optional<VecEnvProbe> reward;
+  /** episode ends when the probe reads `doneValue` */
+  std::optional<VecEnvProbe> done;
+  std::uint8_t doneValue = 0;
+  /** episode ends after this many frames; unlimited if 0 */
+  std::uint32_t maxEpisodeFrames = 0;
+  /** environment i draws CXKK results from stream i of this seed */
+  std::uint64_t seed = 0;
+};
+
+struct VecEnvHeader {
+  constexpr static std::array<char, 4> MAGIC{'C', '8', 'V', 'E'};
+  constexpr static std::uint32_t VERSION = 2;
+
+  std::array<char, 4> magic;
+  std::uint32_t version;
+  std::uint32_t numEnvs;
+  std::uint32_t framesPerStep;
+  /** futex words; must be alone on their lines */
+  alignas(64) std::atomic<std::uint32_t> stepRequest;
+  alignas(64) std::atomic<std::uint32_t> stepDone;
+  alignas(64) std::atomic<std::uint32_t> shutdown;
+  /** workers still stepping in the current generation */
+  std::atomic<std::uint32_t> pending;
+};
+
+/**
+ * @brief one environment; a cache line of control data followed by the
+ * observation, so that workers never share lines
+ */
+struct alignas(64) VecEnvSlot {
+  // written by the client
+  /** bit k set: key k held for the whole step */
+  std::uint16_t action;
+  /** nonzero: restore the initial state before stepping */
+  std::uint8_t reset;
+  std::uint8_t reserved0;
+
+  // written by the server
+  std::uint8_t done;
+  /** nonzero if the interpreter raised an error; implies done */
+  std::uint8_t error;
+  /** nonzero if the observation is 128x64 rather than 64x32 */
+  std::uint8_t highResolution;
+  std::uint8_t reserved1;
+  float reward;
+  std::uint32_t episodeFrames;
+
+  /**
+   * pixel (x, y) is bit x % 64 of observation[y][x / 64], set if the pixel
+   * is lit in any plane; rows and columns outside the current resolution are
+   * zero
+   */
+  alignas(64) std::array<Screen::Row, Screen::HIRES_HEIGHT> observation;
+};
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+
+/**
+ * @brief hosts the environments and serves steps until a client requests
+ * shutdown. The segment is unlinked on destruction
+ */
+class VecEnvServer {
+public:
+  VecEnvServer(const VecEnvServer &) = delete;
+  VecEnvServer(VecEnvServer &&) = delete;
+  VecEnvServer &operator=(const VecEnvServer &) = delete;
+  VecEnvServer &operator=(VecEnvServer &&) = delete;
+
+  /**
+   * @param name POSIX shared-memory name, e.g. "/chip8-vecenv"
+   * @throws std::system_error if the segment cannot be created
+   */
+  VecEnvServer(std::string name, std::span<const std::uint8_t> program,
+               VecEnvConfig config);
+
+  ~VecEnvServer();
+
+  /**
+   * @brief block serving steps until shutdown
+   */
+  void Serve();
+
+private:
+  struct Env {
+    std::unique_ptr<Chip8Core> core;
+    std::uint8_t lastReward = 0;
+    std::uint64_t episodes = 0;
+  };
+
+  /** each episode starts 2^32 draws further along its environment's stream */
+  constexpr static unsigned int EPISODE_DRAWS_SHIFT = 32;
+
+  void RunWorker(std::size_t first, std::size_t last);
+
+  void StepEnv(std::size_t index);
+
+  void ResetEnv(std::size_t index);
+
+  std::string _name;
+  VecEnvConfig _config;
+  std::size_t _bytes;
+  VecEnvHeader *_header = nullptr;
+  std::span<VecEnvSlot> _slots;
+  std::vector<Env> _envs;
+  SaveState _initial{};
+};
+
+/**
+ * @brief the training side: maps an existing segment and steps it
+ */
+class VecEnvClient {
+public:
+  VecEnvClient(const VecEnvClient &) = delete;
+  VecEnvClient(VecEnvClient &&) = delete;
+  VecEnvClient &operator=(const VecEnvClient &) = delete;
+  VecEnvClient &operator=(VecEnvClient &&) = delete;
+
+  /**
+   * @throws std::system_error if the segment does not exist, or
+   * std::runtime_error if it is not a compatible environment
+   */
+  explicit VecEnvClient(const std::string &name);
+
+  ~VecEnvClient();
+
+  /**
+   * @brief actions in, observations out; valid while the client exists
+   */
+  [[nodiscard]] std::span<VecEnvSlot> Slots() const { return _slots; }
+
+  /**
+   * @brief step every environment and wait for the results
+   */
+  void Step();
+
+  /**
+   * @brief ask the server to exit
+   */
+  void Shutdown();
+
+private:
+  std::size_t _bytes = 0;
+  VecEnvHeader *_header = nullptr;
+  std::span<VecEnvSlot> _slots;
+};
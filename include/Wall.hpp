@@ -0,0 +1,109 @@
+#pragma once
+#include "Chip8Core.hpp"
+#include "Metrics.hpp"
+#include "Screen.hpp"
+#include "Threading.hpp"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_events.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_stdinc.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <vector>
+
+/**
+ * @brief a window that shows many headless machines at once. Every machine
+ * gets a tile of one atlas texture; each frame the wall runs every machine
+ * for a frame, re-converts only the tiles whose screens changed and draws the
+ * whole atlas with one SDL_RenderCopy. Machines and rendering share the
+ * calling thread.
+ *
+ * Keyboard input goes to the focused machine, outlined in the atlas. Tab and
+ * Shift+Tab, the arrow keys or a click move the focus
+ */
+class WallManager {
+public:
+  WallManager(const WallManager &) = delete;
+  WallManager(WallManager &&) = delete;
+  WallManager &operator=(const WallManager &) = delete;
+  WallManager &operator=(WallManager &&) = delete;
+
+  /**
+   * @param instances at least one machine, with programs loaded
+   */
+  explicit WallManager(std::vector<std::unique_ptr<Chip8Core>> instances);
+
+  /**
+   * @brief run every machine at 60Hz and present after each frame until the
+   * window is closed
+   */
+  void Run();
+
+  /**
+   * @brief one line: tiles, frames presented and tiles uploaded
+   */
+  void WriteSummary(std::ostream &out) const;
+
+  /**
+   * @brief convert a screen to a tile of TILE_WIDTH x TILE_HEIGHT texture
+   * pixels; low resolution screens are doubled to fill it
+   */
+  static void ConvertTile(const Screen &screen, std::span<Uint32> pixels);
+
+  /** texels per tile: a high resolution screen at one texel per pixel */
+  constexpr static std::size_t TILE_WIDTH = Screen::HIRES_WIDTH;
+
+  constexpr static std::size_t TILE_HEIGHT = Screen::HIRES_HEIGHT;
+
+  ~WallManager();
+
+private:
+  /**
+   * @return whether the event asks to quit
+   */
+  bool HandleEvent(const SDL_Event &event);
+
+  /**
+   * @brief release the keys held on the focused machine and focus `tile`
+   */
+  void Focus(std::size_t tile);
+
+  void RunInstances();
+
+  /**
+   * @brief the part of the atlas that shows `tile`
+   */
+  [[nodiscard]] SDL_Rect TileArea(std::size_t tile) const;
+
+  /**
+   * @brief upload the changed tiles and present the atlas
+   */
+  void Present();
+
+  struct Tile {
+    std::unique_ptr<Chip8Core> core;
+    /** the screen's UpdateCount when the tile was last uploaded */
+    std::uint64_t uploaded;
+    bool stopped = false;
+  };
+
+  /** forces a tile to be uploaded at the next present */
+  constexpr static std::uint64_t STALE = ~std::uint64_t{0};
+
+  SDL_Window *_window = nullptr;
+  SDL_Renderer *_renderer = nullptr;
+  SDL_Texture *_atlas = nullptr;
+  std::vector<Tile> _tiles;
+  std::size_t _columns;
+  std::size_t _rows;
+  std::size_t _focus = 0;
+  /** scratch for one tile's pixels */
+  std::vector<Uint32> _pixels;
+  FramePacer _pacer;
+  Counter _presents;
+  Counter _uploads;
+};
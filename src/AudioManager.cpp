@@ -1,29 +1,49 @@
 #include "AudioManager.hpp"
 #include "SdlError.hpp"
+#include <SDL2/SDL.h>
 #include <SDL2/SDL_audio.h>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <span>
 
 void AudioManager::AudioCallback(void *userdata, uint8_t *stream, int len) {
-  auto frequency = *static_cast<double *>(userdata);
+  auto *self = static_cast<AudioManager *>(userdata);
+  const auto now = std::chrono::steady_clock::now();
+  constexpr static auto BUFFER_PERIOD =
+    std::chrono::duration<double>(static_cast<double>(SAMPLES) / SAMPLE_RATE_HZ);
+  if (self->_lastCallback && now - *self->_lastCallback > BUFFER_PERIOD * 1.5) {
+    self->_underruns.Add();
+  }
+  self->_lastCallback = now;
+  self->_callbacks.Add();
   // NOLINTNEXTLINE(*-reinterpret-cast)
   auto *buffer = reinterpret_cast<int16_t *>(stream);
   const int length = len / 2; // 16-bit samples
-  double phase = 0.0;
-  static constexpr double TWO_PI = 2 * M_PI;
   std::span<int16_t> buffSpan(buffer, length);
-  const double phaseInc = TWO_PI * frequency / SAMPLE_RATE_HZ;
+  if (!self->_tone->load(std::memory_order_relaxed)) {
+    std::fill(buffSpan.begin(), buffSpan.end(), 0);
+    return;
+  }
+  static constexpr double TWO_PI = 2 * M_PI;
+  const double phaseInc = TWO_PI * FREQUENCY_HZ / SAMPLE_RATE_HZ;
   for (auto &elem : buffSpan) {
-    elem = (Sint16)(AMPLITUDE * sin(phase));
-    phase += phaseInc;
-    if (phase > TWO_PI) {
-      phase -= TWO_PI;
+    elem = (Sint16)(AMPLITUDE * sin(self->_phase));
+    self->_phase += phaseInc;
+    if (self->_phase > TWO_PI) {
+      self->_phase -= TWO_PI;
     }
   }
 }
 
-AudioManager::AudioManager() {
+AudioManager::AudioManager(const std::atomic<bool> *tone) : _tone(tone) {}
+
+void AudioManager::Open() {
+  // opening the device can take tens of milliseconds, hence not at startup
+  if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+    throw SdlError();
+  }
   SDL_AudioSpec want;
   SDL_zero(want);
   want.freq = SAMPLE_RATE_HZ;
@@ -32,22 +52,42 @@ AudioManager::AudioManager() {
   want.samples = SAMPLES;
   want.callback = AudioManager::AudioCallback;
 
-  double frequency = FREQUENCY_HZ;
-  want.userdata = &frequency;
+  want.userdata = this;
 
+  // ask for exactly this format so the callback can assume it
   SDL_AudioSpec have;
-  SDL_AudioDeviceID audio_device =
-      SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
-  if (audio_device == 0) {
-    throw SdlError();
+  _audioDevice = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+  if (_audioDevice == 0) {
+    const SdlError error;
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    throw error;
   }
-  PausePlayback();
+  UnpausePlayback();
 }
 
-// NOLINTNEXTLINE(readability*const)
-void AudioManager::UnpausePlayback() { SDL_PauseAudioDevice(_audioDevice, 0); }
+void AudioManager::UnpausePlayback() {
+  // a paused device is not starved; don't count the pause as an underrun
+  SDL_LockAudioDevice(_audioDevice);
+  _lastCallback.reset();
+  SDL_UnlockAudioDevice(_audioDevice);
+  SDL_PauseAudioDevice(_audioDevice, 0);
+}
 
 // NOLINTNEXTLINE(readability*const)
 void AudioManager::PausePlayback() { SDL_PauseAudioDevice(_audioDevice, 1); }
 
-AudioManager::~AudioManager() { SDL_CloseAudioDevice(_audioDevice); }
\ No newline at end of file
+void AudioManager::RegisterMetrics(MetricsRegistry &registry) const {
+  registry.Add("chip8_audio_callbacks_total", "Audio buffers requested by SDL",
+               _callbacks);
+  registry.Add("chip8_audio_underruns_total",
+               "Audio buffers requested late enough that the device likely "
+               "ran out of samples",
+               _underruns);
+}
+
+AudioManager::~AudioManager() {
+  if (IsOpen()) {
+    SDL_CloseAudioDevice(_audioDevice);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+  }
+}
\ No newline at end of file
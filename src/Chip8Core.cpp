@@ -0,0 +1,85 @@
+#include "Chip8Core.hpp"
+#include <cstring>
+#include <memory>
+
+Chip8Core::Chip8Core() : _chip(&_keyboard, &_screen) {}
+
+std::unique_ptr<Chip8Core> Chip8Core::Create() {
+  // the constructor is private so instances always live on the heap; the
+  // interpreter holds pointers to the keyboard and screen
+  std::unique_ptr<Chip8Core> core{new Chip8Core()};
+  core->Reset();
+  return core;
+}
+
+void Chip8Core::Reset() {
+  _keyboard.Reset();
+  _chip.Reset();
+}
+
+void Chip8Core::LoadProgram(const std::filesystem::path &path) {
+  _chip.LoadProgram(path);
+}
+
+void Chip8Core::LoadProgram(std::span<const std::uint8_t> program) {
+  _chip.LoadProgram(program);
+}
+
+bool Chip8Core::ConfirmLoop(std::size_t period) {
+  if (!_loopStates) {
+    // fully overwritten by Save
+    _loopStates = std::make_unique_for_overwrite<std::array<SaveState, 2>>();
+  }
+  auto &[before, after] = *_loopStates;
+  _chip.Save(before);
+  const auto waiting = _chip.WaitingForKey();
+  for (std::size_t frame = 0; frame < period; ++frame) {
+    _chip.RunFrame();
+  }
+  _chip.Save(after);
+  // the payload has no padding, so equal bytes mean equal states
+  return _chip.WaitingForKey() == waiting &&
+         std::memcmp(&before.payload, &after.payload,
+                     sizeof(SaveStatePayload)) == 0;
+}
+
+Chip8Core::FrameRun Chip8Core::RunFrames(std::size_t count) {
+  // Brent: compare every state's hash with a checkpoint's, which moves to the
+  // current state whenever the distance to it reaches the next power of two.
+  // Once the checkpoint is inside a loop of period p, the first match comes p
+  // frames after it
+  FrameRun run;
+  auto checkpoint = _chip.StateHash();
+  std::size_t power = 1;
+  std::size_t distance = 0;
+  while (run.executed < count) {
+    _chip.RunFrame();
+    ++run.executed;
+    ++distance;
+    const auto hash = _chip.StateHash();
+    // with less than a period left there is nothing to skip
+    if (hash == checkpoint && count - run.executed >= distance) {
+      const auto confirmed = ConfirmLoop(distance);
+      run.executed += distance;
+      if (confirmed) {
+        run.loopPeriod = distance;
+        const auto remainder = (count - run.executed) % distance;
+        for (std::size_t frame = 0; frame < remainder; ++frame) {
+          _chip.RunFrame();
+        }
+        run.executed += remainder;
+        return run;
+      }
+      // a hash collision: start over from here
+      checkpoint = _chip.StateHash();
+      distance = 0;
+      continue;
+    }
+    if (distance == power) {
+      checkpoint = hash;
+      power *= 2;
+      distance = 0;
+    }
+  }
+  return run;
+}
@@ -0,0 +1,201 @@
+#include "DebugServer.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <poll.h>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+static_assert(ActiveDebugger::ENABLED,
+              "the debug server needs CHIP8_ENABLE_DEBUGGER");
+
+namespace {
+constexpr int POLL_INTERVAL_MS = 100;
+
+std::size_t ParseNumber(const std::string &text) {
+  return std::stoul(text, nullptr, 0);
+}
+} // namespace
+
+DebugServer::DebugServer(Chip8 *chip, std::filesystem::path socketPath)
+    : _chip(chip), _socketPath(std::move(socketPath)) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const auto pathString = _socketPath.string();
+  if (pathString.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Debug socket path too long: " + pathString);
+  }
+  std::copy(pathString.begin(), pathString.end(), &address.sun_path[0]);
+  std::filesystem::remove(_socketPath);
+
+  _listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  // NOLINTNEXTLINE(*-reinterpret-cast)
+  if (_listener < 0 || bind(_listener, reinterpret_cast<sockaddr *>(&address),
+                            sizeof(address)) != 0 ||
+      listen(_listener, 1) != 0) {
+    const std::string error = std::strerror(errno);
+    if (_listener >= 0) {
+      close(_listener);
+    }
+    throw std::runtime_error("Cannot listen on " + pathString + ": " + error);
+  }
+  _thread = std::thread([this]() { Serve(); });
+}
+
+DebugServer::~DebugServer() {
+  _stopping = true;
+  _thread.join();
+  close(_listener);
+  std::filesystem::remove(_socketPath);
+}
+
+void DebugServer::Serve() {
+  while (!_stopping) {
+    pollfd listener{_listener, POLLIN, 0};
+    if (poll(&listener, 1, POLL_INTERVAL_MS) <= 0) {
+      continue;
+    }
+    const int client = accept(_listener, nullptr, nullptr);
+    if (client >= 0) {
+      ServeClient(client);
+      close(client);
+    }
+  }
+}
+
+void DebugServer::ServeClient(int client) {
+  constexpr static std::size_t READ_SIZE = 512;
+  std::string pending;
+  std::array<char, READ_SIZE> buffer{};
+  while (!_stopping) {
+    pollfd connection{client, POLLIN, 0};
+    if (poll(&connection, 1, POLL_INTERVAL_MS) <= 0) {
+      continue;
+    }
+    const auto received = read(client, buffer.data(), buffer.size());
+    if (received <= 0) {
+      return;
+    }
+    pending.append(buffer.data(), static_cast<std::size_t>(received));
+    for (auto newline = pending.find('\n'); newline != std::string::npos;
+         newline = pending.find('\n')) {
+      const auto line = pending.substr(0, newline);
+      pending.erase(0, newline + 1);
+      std::string response;
+      try {
+        response = HandleCommand(line);
+      } catch (const std::exception &e) {
+        response = std::string("error ") + e.what();
+      }
+      response += '\n';
+      if (write(client, response.data(), response.size()) < 0) {
+        return;
+      }
+    }
+  }
+}
+
+// NOLINTNEXTLINE(*cognitive-complexity)
+std::string DebugServer::HandleCommand(const std::string &line) {
+  auto &debugger = _chip->GetDebugger();
+  std::istringstream words(line);
+  std::string command;
+  words >> command;
+  std::vector<std::string> args;
+  for (std::string arg; words >> arg;) {
+    args.push_back(arg);
+  }
+  const auto arg = [&args](std::size_t i, const std::string &fallback = "") {
+    if (i < args.size()) {
+      return args[i];
+    }
+    if (fallback.empty()) {
+      throw std::invalid_argument("missing argument");
+    }
+    return fallback;
+  };
+  const auto status = [&debugger]() {
+    return debugger.IsPaused() ? "paused " + debugger.PauseReason()
+                               : std::string("running");
+  };
+
+  if (command == "break" || command == "unbreak") {
+    debugger.SetBreakpoint(ParseNumber(arg(0)), command == "break");
+  } else if (command == "watch") {
+    const auto kind = arg(0);
+    debugger.SetWatchpoint(ParseNumber(arg(1)), ParseNumber(arg(2, "1")),
+                           kind.find('r') != std::string::npos,
+                           kind.find('w') != std::string::npos);
+  } else if (command == "unwatch") {
+    debugger.SetWatchpoint(ParseNumber(arg(0)), ParseNumber(arg(1, "1")),
+                           false, false);
+  } else if (command == "cond") {
+    const auto reg = arg(0);
+    if (reg.size() != 2 || (reg[0] != 'V' && reg[0] != 'v')) {
+      throw std::invalid_argument("expected a register V0-VF");
+    }
+    const auto op = arg(1);
+    Debugger::Comparison comparison{};
+    if (op == "==") {
+      comparison = Debugger::Comparison::EQUAL;
+    } else if (op == "!=") {
+      comparison = Debugger::Comparison::NOT_EQUAL;
+    } else if (op == "<") {
+      comparison = Debugger::Comparison::LESS;
+    } else if (op == ">") {
+      comparison = Debugger::Comparison::GREATER;
+    } else {
+      throw std::invalid_argument("unknown comparison " + op);
+    }
+    debugger.AddCondition({std::stoul(reg.substr(1), nullptr, 16), comparison,
+                           static_cast<int>(ParseNumber(arg(2)))});
+  } else if (command == "uncond") {
+    debugger.ClearConditions();
+  } else if (command == "pause") {
+    debugger.Pause();
+  } else if (command == "continue") {
+    debugger.Continue();
+  } else if (command == "step") {
+    debugger.Step(ParseNumber(arg(0, "1")));
+  } else if (command == "wait") {
+    debugger.WaitUntilPaused(
+      std::chrono::milliseconds{ParseNumber(arg(0, "1000"))});
+    return status();
+  } else if (command == "status") {
+    return status();
+  } else if (command == "regs" || command == "mem") {
+    if (!debugger.IsPaused()) {
+      throw std::runtime_error("machine is running");
+    }
+    std::stringstream out;
+    out << std::hex << std::uppercase;
+    if (command == "regs") {
+      const auto state = _chip->GetState();
+      out << "PC=" << state.programCounter << " I=" << state.index
+          << " SP=" << +state.stackDepth << " DT=" << +state.delayTimer
+          << " ST=" << +state.soundTimer;
+      for (std::size_t i = 0; i < state.registers.size(); ++i) {
+        out << " V" << i << '=' << +state.registers.at(i);
+      }
+    } else {
+      const auto address = std::min(ParseNumber(arg(0)), Chip8::MEMORY_BYTES);
+      std::vector<std::uint8_t> bytes(
+        std::min(ParseNumber(arg(1)), Chip8::MEMORY_BYTES - address));
+      _chip->ReadMemory(address, bytes);
+      for (const auto byte : bytes) {
+        out << std::setw(2) << std::setfill('0') << +byte << ' ';
+      }
+    }
+    return out.str();
+  } else {
+    throw std::invalid_argument("unknown command " + command);
+  }
+  return "ok";
+}
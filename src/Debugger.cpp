@@ -0,0 +1,170 @@
+#include "Debugger.hpp"
+#include <sstream>
+
+namespace {
+std::string Hex(std::size_t value) {
+  std::stringstream stream;
+  stream << "0x" << std::hex << std::uppercase << value;
+  return stream.str();
+}
+} // namespace
+
+void Debugger::SetBreakpoint(std::size_t address, bool enabled) {
+  // tested directly by BeforeInstruction
+  _breakpoints.Set(address, enabled);
+}
+
+void Debugger::SetWatchpoint(std::size_t address, std::size_t length,
+                             bool onRead, bool onWrite) {
+  for (std::size_t i = 0; i < length; ++i) {
+    _readWatches.Set(address + i, onRead);
+    _writeWatches.Set(address + i, onWrite);
+  }
+}
+
+void Debugger::AddCondition(Condition condition) {
+  std::unique_lock lock{_mutex};
+  _conditions.push_back(condition);
+  _conditionWasTrue.push_back(false);
+  UpdateArmed();
+}
+
+void Debugger::ClearConditions() {
+  std::unique_lock lock{_mutex};
+  _conditions.clear();
+  _conditionWasTrue.clear();
+  UpdateArmed();
+}
+
+void Debugger::Pause() {
+  std::unique_lock lock{_mutex};
+  _pauseRequested = true;
+  UpdateArmed();
+}
+
+void Debugger::Continue() {
+  std::unique_lock lock{_mutex};
+  _stepping = false;
+  _paused = false;
+  UpdateArmed();
+  _stateChanged.notify_all();
+}
+
+void Debugger::Step(std::size_t count) {
+  std::unique_lock lock{_mutex};
+  _stepping = true;
+  _stepsRemaining = count;
+  _paused = false;
+  UpdateArmed();
+  _stateChanged.notify_all();
+}
+
+void Debugger::Detach() {
+  _breakpoints.Clear();
+  _readWatches.Clear();
+  _writeWatches.Clear();
+  std::unique_lock lock{_mutex};
+  _conditions.clear();
+  _conditionWasTrue.clear();
+  _stepping = false;
+  _pauseRequested = false;
+  _paused = false;
+  _detached = true;
+  UpdateArmed();
+  _stateChanged.notify_all();
+}
+
+bool Debugger::WaitUntilPaused(std::chrono::milliseconds timeout) {
+  std::unique_lock lock{_mutex};
+  return _stateChanged.wait_for(lock, timeout, [this]() { return _paused; });
+}
+
+bool Debugger::IsPaused() const {
+  std::unique_lock lock{_mutex};
+  return _paused;
+}
+
+std::string Debugger::PauseReason() const {
+  std::unique_lock lock{_mutex};
+  return _pauseReason;
+}
+
+void Debugger::RecordWatchHit(const char *kind, std::size_t address) {
+  std::unique_lock lock{_mutex};
+  if (_watchHit.empty() && !_detached) {
+    _watchHit = std::string("watch ") + kind + ' ' + Hex(address);
+    UpdateArmed();
+  }
+}
+
+bool Debugger::Evaluate(const Condition &condition,
+                        std::span<const Byte> registers) {
+  const auto value = registers[condition.reg % registers.size()];
+  switch (condition.comparison) {
+  case Comparison::EQUAL:
+    return value == condition.value;
+  case Comparison::NOT_EQUAL:
+    return value != condition.value;
+  case Comparison::LESS:
+    return value < condition.value;
+  case Comparison::GREATER:
+    return value > condition.value;
+  }
+  return false;
+}
+
+// must hold _mutex
+void Debugger::UpdateArmed() {
+  _pending.store(!_detached && (_pauseRequested || _stepping ||
+                                !_watchHit.empty()),
+                 std::memory_order_relaxed);
+  _conditionsArmed.store(!_detached && !_conditions.empty(),
+                         std::memory_order_relaxed);
+}
+
+void Debugger::CheckBreak(std::size_t programCounter,
+                          std::span<const Byte> registers) {
+  std::unique_lock lock{_mutex};
+  if (_detached) {
+    return;
+  }
+  std::string reason;
+  if (_pauseRequested) {
+    reason = "pause";
+  } else if (!_watchHit.empty()) {
+    reason = _watchHit;
+  } else if (_breakpoints.Test(programCounter)) {
+    reason = "breakpoint " + Hex(programCounter);
+  }
+  for (std::size_t i = 0; i < _conditions.size(); ++i) {
+    // only break when a condition becomes true, not while it stays true
+    const bool isTrue = Evaluate(_conditions[i], registers);
+    if (isTrue && !_conditionWasTrue[i] && reason.empty()) {
+      reason = "condition " + std::to_string(i);
+    }
+    _conditionWasTrue[i] = isTrue;
+  }
+  if (reason.empty() && _stepping) {
+    if (_stepsRemaining == 0) {
+      reason = "step";
+    } else {
+      --_stepsRemaining;
+    }
+  }
+  if (reason.empty()) {
+    return;
+  }
+
+  _pauseRequested = false;
+  _stepping = false;
+  _watchHit.clear();
+  _pauseReason = reason + " at PC=" + Hex(programCounter);
+  _paused = true;
+  UpdateArmed();
+  _stateChanged.notify_all();
+  _stateChanged.wait(lock, [this]() { return !_paused || _detached; });
+  // the instruction we paused on runs now, without being re-checked
+  if (_stepping && _stepsRemaining > 0) {
+    --_stepsRemaining;
+  }
+}
@@ -1,23 +1,168 @@
 #include "Emulator.hpp"
 #include "Keyboard.hpp"
 #include "Screen.hpp"
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
 #include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 
-Emulator::Emulator(const std::filesystem::path &programPath)
-    : _keyboard(std::make_unique<Keyboard>()),
+Emulator::Options Emulator::Options::FromEnvironment(const std::string &prefix) {
+  Options options;
+  const char *frames = std::getenv((prefix + "_HEADLESS_FRAMES").c_str());
+  if (frames != nullptr && *frames != '\0') {
+    const std::string_view value = frames;
+    std::size_t count = 0;
+    const auto [end, error] =
+      std::from_chars(value.data(), value.data() + value.size(), count);
+    if (error != std::errc{} || end != value.data() + value.size()) {
+      throw std::invalid_argument("Invalid " + prefix +
+                                  "_HEADLESS_FRAMES: " + std::string(value));
+    }
+    options.headlessFrames = count;
+  }
+  return options;
+}
+
+Emulator::Emulator(const std::filesystem::path &programPath, Options options)
+    : _started(Clock::now()), _options(options),
+      _keyboard(std::make_unique<Keyboard>()),
       _screen(std::make_unique<Screen>()),
       _chip(std::make_unique<Chip8>(_keyboard.get(), _screen.get())),
-      _ui(std::make_unique<SdlManager>(Screen::WIDTH, Screen::HEIGHT,
-                                       _keyboard.get())) {
-  _chip->LoadProgram(programPath);
-  _screen->RegisterUpdateCallback([this](std::span<bool> frame) {
-    _ui->QueueFrame({frame.begin(), frame.end()});
+      _emulationThread(ThreadOptions::FromEnvironment("CHIP8_EMULATION")) {
+  // only the machine is touched until the load is waited for; if SDL throws,
+  // the future's destructor waits while the machine still exists
+  auto loaded = std::async(std::launch::async, [this, programPath]() {
+    _chip->Reset();
+    _chip->LoadProgram(programPath);
+    // CHIP8_SEED replays a session's CXKK results; otherwise every run
+    // differs
+    const char *seed = std::getenv("CHIP8_SEED");
+    _chip->Random() = RandomNumberGenerator{
+      seed != nullptr ? std::stoull(seed) : std::random_device{}(), 0};
   });
+  if (!_options.Headless()) {
+    _ui = std::make_unique<SdlManager>(Screen::HIRES_WIDTH,
+                                       Screen::HIRES_HEIGHT, _keyboard.get(),
+                                       &_chip->Beeping());
+    _ui->RegisterFirstPresentCallback(
+      [this]() { _firstFrameSeconds.Set(SecondsSinceStart()); });
+  }
+  loaded.get();
+#ifdef CHIP8_ENABLE_DEBUGGER
+  const char *debugSocket = std::getenv("CHIP8_DEBUG_SOCKET");
+  _debugServer = std::make_unique<DebugServer>(
+    _chip.get(), debugSocket != nullptr ? debugSocket : "chip8-debug.sock");
+#endif
+  if (_ui) {
+    _screen->RegisterUpdateCallback([this](const Screen &screen) {
+      _ui->QueueFrame(SdlManager::Frame::Capture(screen));
+    });
+  }
+  auto metricsOptions =
+    MetricsServer::Options::FromEnvironment("CHIP8_METRICS");
+  if (metricsOptions.Enabled()) {
+    _chip->RegisterMetrics(_metrics);
+    _screen->RegisterMetrics(_metrics);
+    if (_ui) {
+      _ui->RegisterMetrics(_metrics);
+    }
+    _metrics.Add("chip8_startup_first_instruction_seconds",
+                 "Time from starting the emulator to its first instruction",
+                 _firstInstructionSeconds);
+    _metrics.Add("chip8_startup_first_frame_seconds",
+                 "Time from starting the emulator to its first frame",
+                 _firstFrameSeconds);
+    _metricsServer =
+      std::make_unique<MetricsServer>(&_metrics, std::move(metricsOptions));
+  }
 }
 
-void Emulator::Run() {
-  std::thread chipThread{[this]() { _chip->Run(); }};
+double Emulator::SecondsSinceStart() const {
+  return std::chrono::duration<double>(Clock::now() - _started).count();
+}
+
+void Emulator::RunWindowed() {
+  std::thread chipThread{[this]() {
+    try {
+      ApplyThreadOptions(_emulationThread);
+    } catch (const std::system_error &e) {
+      std::cerr << "Ignoring emulation thread options: " << e.what() << '\n';
+    }
+    _pacer.emplace(Chip8::FRAME_PERIOD);
+    if (_metricsServer) {
+      _pacer->RegisterMetrics(_metrics, "chip8_emulation");
+    }
+    _firstInstructionSeconds.Set(SecondsSinceStart());
+    try {
+      _chip->Run(*_pacer);
+    } catch (const std::exception &e) {
+      // the trace has already been dumped; keep the window open so the last
+      // frame can be inspected
+      std::cerr << "Emulation stopped: " << e.what() << '\n';
+    }
+    _pacer->WriteSummary(std::cerr, "emulation");
+  }};
   _ui->Run();
   _chip->Cancel();
   chipThread.join();
-}
\ No newline at end of file
+  _ui->WriteSummary(std::cerr);
+}
+
+void Emulator::RunHeadless() {
+  try {
+    ApplyThreadOptions(_emulationThread);
+  } catch (const std::system_error &e) {
+    std::cerr << "Ignoring emulation thread options: " << e.what() << '\n';
+  }
+  std::size_t frames = 0;
+  try {
+    _firstInstructionSeconds.Set(SecondsSinceStart());
+    _chip->RunFrame();
+    _firstFrameSeconds.Set(SecondsSinceStart());
+    for (frames = 1; frames < _options.headlessFrames; ++frames) {
+      _chip->RunFrame();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Emulation stopped: " << e.what() << '\n';
+  }
+  std::cerr << "headless: frames=" << frames << " elapsed_ms=" << std::fixed
+            << std::setprecision(1) << SecondsSinceStart() * 1e3 << '\n';
+}
+
+void Emulator::Run() {
+  if (_options.Headless()) {
+    RunHeadless();
+  } else {
+    RunWindowed();
+  }
+  WriteStartupSummary(std::cerr);
+  // writes the final values to the metrics file, if any
+  _metricsServer.reset();
+#ifdef CHIP8_ENABLE_DEBUGGER
+  _debugServer.reset();
+#endif
+  if constexpr (ActiveProfiler::ENABLED) {
+    std::ofstream json{"chip8-profile.json"};
+    _chip->GetProfiler().WriteJson(json);
+    std::ofstream folded{"chip8-profile.folded"};
+    _chip->GetProfiler().WriteFoldedStacks(folded);
+  }
+}
+
+void Emulator::WriteStartupSummary(std::ostream &out) const {
+  constexpr static double MICROSECONDS = 1e6;
+  out << std::fixed << std::setprecision(1)
+      << "startup: first_instruction_us="
+      << _firstInstructionSeconds.Value() * MICROSECONDS
+      << " first_frame_us=" << _firstFrameSeconds.Value() * MICROSECONDS
+      << '\n';
+}
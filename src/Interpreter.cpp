@@ -1,9 +1,12 @@
 #include "Interpreter.hpp"
+#include "InterpreterExecute.hpp"
 #include "Constants.hpp"
 #include "InstructionError.hpp"
 #include "Screen.hpp"
+#include "StateHash.hpp"
 #include "Types.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cstdio>
@@ -11,329 +14,254 @@
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 Chip8::Chip8(Keyboard *keyboard, Screen *screen)
-    : _keyboard(keyboard), _screen(screen) {
-  constexpr static Timer::Duration TIMER_DELAYS{16666667};
-  _soundTimer = _timerManager.AddTimer(TIMER_DELAYS, false).lock();
-  _delayTimer = _timerManager.AddTimer(TIMER_DELAYS, false).lock();
-  constexpr static Timer::Duration CLOCK_SPEED{2000000};
-  auto clockTimer = _timerManager.AddTimer(CLOCK_SPEED, true);
-  clockTimer.lock()->RegisterCallback(
-      [this](auto &&) { RunNextInstruction(); });
-}
+    : _keyboard(keyboard), _screen(screen), _traceDumpStream(&std::cerr) {}
 
 void Chip8::InitializeMemory() {
-  _memory = {};
-
+  MemoryImage::Storage memory{};
   std::copy(FONT_SET.begin(), FONT_SET.end(),
-            _memory.begin() + MEMORY_OFFSET_FONT);
+            memory.begin() + MEMORY_OFFSET_FONT);
+  std::copy(BIG_FONT_SET.begin(), BIG_FONT_SET.end(),
+            memory.begin() + MEMORY_OFFSET_BIG_FONT);
+  _memory.Map(MemoryImage::Intern(memory));
 }
 
 void Chip8::Reset() {
-  _soundTimer->SetTicks(0);
-  _delayTimer->SetTicks(0);
+  _soundTimer = 0;
+  _delayTimer = 0;
   InitializeMemory();
-  _screen->Clear();
+  _screen->SelectPlanes(1);
+  _screen->SetHighResolution(false);
   _stack = {};
+  _stackPointer = 0;
   _registers = {};
   _index = 0;
+  _programCounter = MEMORY_OFFSET_PROGRAM;
+  _keyPress.reset();
+  _trace.Clear();
 }
 
 void Chip8::LoadProgram(const std::filesystem::path &path) {
-  std::ifstream program(path, std::ios::binary);
+  // opened at the end, so one read takes the whole file
+  std::ifstream program(path, std::ios::binary | std::ios::ate);
   if (!program) {
     throw std::runtime_error("Invalid program path: " + path.string());
   }
-  unsigned int offset = MEMORY_OFFSET_PROGRAM;
-  char byte = 0;
-  while (program.read(&byte, 1)) {
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
-    _memory[offset] = static_cast<unsigned char>(byte);
-    ++offset;
+  std::vector<std::uint8_t> image(static_cast<std::size_t>(program.tellg()));
+  program.seekg(0);
+  // NOLINTNEXTLINE(*-reinterpret-cast)
+  program.read(reinterpret_cast<char *>(image.data()),
+               static_cast<std::streamsize>(image.size()));
+  if (!program) {
+    throw std::runtime_error("Cannot read program: " + path.string());
   }
+  LoadProgram(image);
 }
 
-constexpr int Chip8::ExtractX(int instruction) {
-  // NOLINTNEXTLINE(*-magic-numbers)
-  return (instruction & 0x0F00) >> 8;
-}
-constexpr int Chip8::ExtractY(int instruction) {
-  // NOLINTNEXTLINE(*-magic-numbers)
-  return (instruction & 0x00F0) >> 4;
-}
-
-constexpr int Chip8::ExtractN(int instruction) {
-  // NOLINTNEXTLINE(*-magic-numbers)
-  return instruction & 0x000F;
-}
-
-constexpr int Chip8::ExtractKK(int instruction) {
-  // NOLINTNEXTLINE(*-magic-numbers)
-  return instruction & 0x00FF;
-}
-
-constexpr int Chip8::ExtractNNN(int instruction) {
-  // NOLINTNEXTLINE(*-magic-numbers)
-  return instruction & 0x0FFF;
+void Chip8::LoadProgram(std::span<const std::uint8_t> program) {
+  if (program.size() > MEMORY_BYTES - MEMORY_OFFSET_PROGRAM) {
+    throw std::runtime_error("Program too large: " +
+                             std::to_string(program.size()) + " bytes");
+  }
+  // every machine that loads the same program over the same memory shares
+  // one image until it writes to it
+  auto memory = _memory.Snapshot();
+  std::copy(program.begin(), program.end(),
+            memory.begin() + MEMORY_OFFSET_PROGRAM);
+  _memory.Map(MemoryImage::Intern(memory));
 }
 
-int Chip8::FetchInstruction() {
-  // NOLINTBEGIN(*-array-index, *-magic-numbers)
-  const auto byteOne = _memory[_programCounter];
-  const auto byteTwo = _memory[_programCounter + 1];
-  return byteOne << Constants::BITS_PER_BYTE | byteTwo;
-  // NOLINTEND(*-array-index, *-magic-numbers)
-}
+int Chip8::FetchInstruction() { return _memory.Fetch(_programCounter); }
 
 void Chip8::StackPush(unsigned short val) {
-  if (_stack.size() >= STACK_SIZE) {
+  if (_stackPointer >= STACK_SIZE) {
     throw std::runtime_error("stack overflow");
   }
-  _stack.push(val);
+  // NOLINTNEXTLINE(*-array-index)
+  _stack[_stackPointer++] = val;
 }
 
 unsigned short Chip8::StackPop() {
-  if (_stack.empty()) {
+  if (_stackPointer == 0) {
     throw std::runtime_error("stack underflow");
   }
-  const auto top = _stack.top();
-  _stack.pop();
-  return top;
+  // NOLINTNEXTLINE(*-array-index)
+  return _stack[--_stackPointer];
 }
 
-void Chip8::IncrementPC() { _programCounter += 2; }
-
-// NOLINTNEXTLINE(*cognitive-complexity)
-void Chip8::ExecuteInstruction(Instruction instruction) {
-  // NOLINTBEGIN(*magic-numbers, *-array-index)
-  const auto Y = ExtractY(instruction);
-  const auto X = ExtractX(instruction);
-  const auto N = ExtractN(instruction);
-  const auto KK = ExtractKK(instruction);
-  const auto NNN = ExtractNNN(instruction);
-  auto *VX = Register(X);
-  auto *VY = Register(Y);
-  auto *carry = Register(0xF);
-  const auto setCarry = [carry](bool value) {
-    *carry = static_cast<int>(value);
-  };
-
-  const auto firstNibble = static_cast<Opcodes>(instruction & 0xF000);
-  const auto lastNibble = static_cast<Opcodes>(instruction & 0x000F);
-  if (static_cast<int>(firstNibble) == 0) {
-    switch (lastNibble) {
-    case Opcodes::ADD_VX_VY: {
-      setCarry(*VX > 0xFF - *VY);
-      *VX += *VY;
-      break;
+void Chip8::RunNextInstruction() {
+  // a PC that runs off the end of memory, or a BNNN past it, wraps
+  _programCounter &= MEMORY_BYTES - 1;
+  _memory.Policy().BeforeInstruction(_programCounter, _registers);
+  const auto nextInstruction = FetchInstruction();
+  _profiler.OnInstruction(_programCounter, nextInstruction);
+  auto &traceEntry = _trace.Begin(_programCounter, nextInstruction, _index);
+  IncrementPC();
+  try {
+    ExecuteInstruction(nextInstruction);
+  } catch (const std::exception &e) {
+    if (_traceDumpStream != nullptr) {
+      *_traceDumpStream << e.what() << "\nLast instructions:\n";
+      DumpTrace(*_traceDumpStream);
     }
+    throw;
+  }
+  traceEntry.vx =
+    static_cast<std::uint8_t>(*Register(ExtractX(nextInstruction)));
+  // NOLINTNEXTLINE(*-magic-numbers)
+  traceEntry.vf = static_cast<std::uint8_t>(*Register(0xF));
+  if (_traceFile) {
+    _traceFile->Write(traceEntry);
+  }
+}
 
-    case Opcodes::RETURN:
-      _programCounter = StackPop();
-      break;
-
-    case Opcodes::CLEAR_SCREEN:
-      _screen->Clear();
-      break;
-
-    default:
-      throw InstructionError(instruction);
+void Chip8::Step(std::size_t count) {
+  std::size_t executed = 0;
+  try {
+    for (; executed < count; ++executed) {
+      RunNextInstruction();
     }
-  } else {
-    switch (firstNibble) {
-
-    case Opcodes::LOAD_VX_KK:
-      *VX = KK;
-      break;
-
-    case Opcodes::E_OPS:
-      switch (static_cast<EOps>(lastNibble)) {
-      case EOps::SKIP_VX_PRESSED:
-        if (_keyboard->IsKeyPressed(*VX)) {
-          IncrementPC();
-        }
-        break;
-      case EOps::SKIP_VX_NOT_PRESSED:
-        if (!_keyboard->IsKeyPressed(*VX)) {
-          IncrementPC();
-        }
-        break;
-      default:
-        throw InstructionError(instruction);
-      }
-      break;
-
-    case Opcodes::F_OPS:
-      switch (static_cast<FOps>(instruction & 0x00FF)) {
-      case FOps::LOAD_DELAY_VX:
-        *VX = static_cast<Byte>(_delayTimer->GetTicks());
-        break;
-      case FOps::WAIT_KEY_VX: {
-        auto keyPress = _keyboard->GetNextKeyPress();
-        keyPress.wait();
-        *VX = static_cast<Byte>(keyPress.get());
-        break;
-      }
-      case FOps::SET_DELAY_VX:
-        _delayTimer->SetTicks(*VX);
-        break;
-      case FOps::SET_SOUND_VX:
-        _soundTimer->SetTicks(*VX);
-        break;
-      case FOps::ADD_VX_TO_I:
-        _index += *VX;
-        break;
-      case FOps::SET_I_VX_SPRITE:
-        _index = MEMORY_OFFSET_FONT + *VX;
-        break;
-      case FOps::SET_MEM_I_DECIMAL_VX: {
-        const auto tc = *VX;
-        const Byte hundreds = tc / 100;
-        const Byte tens = (tc % 100) / 10;
-        const Byte ones = tc % 10;
-        _memory[_index] = hundreds;
-        _memory[_index + 1] = tens;
-        _memory[_index + 2] = ones;
-        break;
-      }
-      case FOps::STORE_MEM_I_V0_TO_VX: {
-        std::copy(_registers.begin(), _registers.begin() + X + 1,
-                  _memory.begin() + _index);
-        break;
-      }
-      case FOps::LOAD_V0_TO_VX_FROM_MEM_AT_I: {
-        std::copy(_memory.begin() + _index, _memory.begin() + _index + X + 1,
-                  _registers.begin());
-        break;
-      }
-      default:
-        throw InstructionError(instruction);
-      }
-      break;
-
-    case Opcodes::EIGHT_OPS:
-      switch (static_cast<EightOps>(lastNibble)) {
-      case EightOps::LOAD_VX_VY:
-        *VX = *VY;
-        break;
-      case EightOps::OR_VX_VY:
-        *VX |= *VY;
-        break;
-      case EightOps::AND_VX_VY:
-        *VX &= *VY;
-        break;
-      case EightOps::XOR_VX_VY:
-        *VX ^= *VY;
-        break;
-      case EightOps::ADD_VX_VY: {
-        const auto sum = *VX + *VY;
-        *VX = sum & 0xFF;
-        setCarry(sum > 0xFF);
-        break;
-      }
-      case EightOps::SUB_VX_VY: {
-        const Byte x = *VX;
-        const Byte y = *VY;
-        *VX = (x - y) & 0xFF;
-        setCarry(y <= x);
-        break;
-      }
-      case EightOps::SHIFT_RIGHT_VX: {
-        const auto x = *VX;
-        *VX >>= 1;
-        setCarry(((x & 1) != 0));
-        break;
-      }
-      case EightOps::SUBN_VX_VY: {
-        const unsigned int x = *VX;
-        const unsigned int y = *VY;
-        *VX = static_cast<Byte>(y - x) & 0xFF;
-        setCarry(y >= x);
-        break;
-      }
-      case EightOps::SHIFT_LEFT_VX: {
-        const auto x = *VX;
-        *VX = (x << 1) & 0xFF;
-        setCarry((x & 0b10000000) != 0);
-        break;
-      }
-      default:
-        throw InstructionError(instruction);
-      }
-      break;
-
-    case Opcodes::ADD_VX_KK:
-      *VX = (*VX + KK) & 0xFF;
-      break;
-
-    case Opcodes::JUMP_NNN:
-      _programCounter = NNN;
-      break;
+  } catch (...) {
+    // the instructions before the faulting one ran; count them as the
+    // instance stops
+    _instructions.Add(executed);
+    throw;
+  }
+  _instructions.Add(count);
+}
 
-    case Opcodes::JUMP_V0_NNN:
-      _programCounter = NNN + *Register(0);
-      break;
+void Chip8::RunFrame() {
+  Step(INSTRUCTIONS_PER_FRAME);
+  TickFrameTimers();
+}
 
-    case Opcodes::CALL_NNN:
-      StackPush(_programCounter);
-      _programCounter = NNN;
-      break;
+void Chip8::TickFrameTimers() {
+  for (auto *timer : {&_delayTimer, &_soundTimer}) {
+    if (*timer > 0) {
+      --*timer;
+    }
+  }
+  _beeping.value.store(_soundTimer > 0, std::memory_order_relaxed);
+  _frames.Add();
+}
 
-    case Opcodes::SET_INDEX_NNN:
-      _index = NNN;
-      break;
+void Chip8::RegisterMetrics(MetricsRegistry &registry) const {
+  registry.Add("chip8_instructions_total", "Instructions executed",
+               _instructions);
+  registry.Add("chip8_frames_total", "60Hz frames run", _frames);
+}
 
-    case Opcodes::SKIP_VX_EQ_KK:
-      if (*VX == KK) {
-        IncrementPC();
-      }
-      break;
+void Chip8::Run(FramePacer &pacer) {
+  _programCounter = MEMORY_OFFSET_PROGRAM;
+  while (!_cancelled.value.load(std::memory_order_relaxed)) {
+    RunFrame();
+    pacer.Wait();
+  }
+  _beeping.value = false;
+}
 
-    case Opcodes::SKIP_VX_NEQ_KK:
-      if (*VX != KK) {
-        IncrementPC();
-      }
-      break;
+void Chip8::Cancel() {
+  _cancelled.value = true;
+  _memory.Policy().Detach();
+}
 
-    case Opcodes::SKIP_VX_EQ_VY:
-      if (*VX == *VY) {
-        IncrementPC();
-      }
-      break;
+Chip8::State Chip8::GetState() const {
+  State state{};
+  static_assert(std::tuple_size_v<decltype(state.registers)> ==
+                NUM_REGISTERS + NUM_CARRY);
+  std::transform(_registers.begin(), _registers.end(), state.registers.begin(),
+                 [](Byte reg) { return static_cast<std::uint8_t>(reg); });
+  state.programCounter = static_cast<std::uint16_t>(_programCounter);
+  state.index = static_cast<std::uint16_t>(_index);
+  state.stackDepth = static_cast<std::uint8_t>(_stackPointer);
+  state.delayTimer = _delayTimer;
+  state.soundTimer = _soundTimer;
+  return state;
+}
 
-    case Opcodes::SKIP_VX_NEQ_VY:
-      if (*VX != *VY) {
-        IncrementPC();
-      }
-      break;
+std::uint64_t Chip8::StateHash() {
+  StateHasher hasher{_memory.Hash()};
+  hasher.Add(_screen->Hash());
+  hasher.Add(_rng.Key());
+  hasher.Add(_rng.Position());
+  // NOLINTBEGIN(*-magic-numbers)
+  hasher.Add(static_cast<std::uint64_t>(_programCounter) |
+             static_cast<std::uint64_t>(_index) << 16 |
+             static_cast<std::uint64_t>(_stackPointer) << 32 |
+             static_cast<std::uint64_t>(_delayTimer) << 40 |
+             static_cast<std::uint64_t>(_soundTimer) << 48 |
+             static_cast<std::uint64_t>(WaitingForKey()) << 56);
+  // NOLINTEND(*-magic-numbers)
+  std::array<std::uint8_t, NUM_REGISTERS + NUM_CARRY> registers{};
+  std::transform(_registers.begin(), _registers.end(), registers.begin(),
+                 [](Byte reg) { return static_cast<std::uint8_t>(reg); });
+  hasher.AddBytes(std::as_bytes(std::span(registers)));
+  hasher.AddBytes(std::as_bytes(std::span(_flags)));
+  hasher.AddBytes(std::as_bytes(std::span(_stack)));
+  return hasher.Value();
+}
 
-    case Opcodes::RND_VX_KK:
-      *VX = _rng.Generate() & NNN;
-      break;
+void Chip8::DumpTrace(std::ostream &out) const {
+  WriteTrace(out, _trace.Entries());
+}
 
-    case Opcodes::DRAW: {
-      _screen->Draw(*VX, *VY, std::span(_memory).subspan(_index, N));
-      break;
-    }
-    default:
-      throw InstructionError(instruction);
-    }
-  }
-  // NOLINTEND(*magic-numbers, *-array-index)
+void Chip8::StartTraceFile(const std::filesystem::path &path) {
+  _traceFile = std::make_unique<TraceWriter>(path);
 }
 
-void Chip8::RunNextInstruction() {
-  const auto nextInstruction = FetchInstruction();
-  IncrementPC();
-  ExecuteInstruction(nextInstruction);
+void Chip8::StopTraceFile() { _traceFile.reset(); }
+
+void Chip8::Save(SaveState &state) const {
+  static_assert(SaveStatePayload::MEMORY_BYTES == MEMORY_BYTES);
+  static_assert(SaveStatePayload::STACK_SIZE == STACK_SIZE);
+  static_assert(SaveStatePayload::NUM_REGISTERS == NUM_REGISTERS + NUM_CARRY);
+  static_assert(SaveStatePayload::NUM_FLAGS == NUM_FLAGS);
+  auto &payload = state.payload;
+  payload.memory = _memory.Snapshot();
+  _screen->Save(payload.framebuffer);
+  payload.highResolution = _screen->HighResolution() ? 1 : 0;
+  payload.planes = static_cast<std::uint8_t>(_screen->SelectedPlanes());
+  _rng.Save(payload.rng);
+  payload.stack = _stack;
+  std::transform(_registers.begin(), _registers.end(),
+                 payload.registers.begin(),
+                 [](Byte reg) { return static_cast<std::uint8_t>(reg); });
+  payload.programCounter = static_cast<std::uint16_t>(_programCounter);
+  payload.index = static_cast<std::uint16_t>(_index);
+  payload.stackPointer = static_cast<std::uint8_t>(_stackPointer);
+  payload.delayTimer = _delayTimer;
+  payload.soundTimer = _soundTimer;
+  payload.flags = _flags;
+  payload.quirks = 0;
+  payload.reserved1 = {};
+  state.Seal();
 }
 
-void Chip8::Run() {
-  _programCounter = MEMORY_OFFSET_PROGRAM;
-  while (!_cancelled) {
-    _timerManager.Tick();
-  }
+void Chip8::Load(const SaveState &state) {
+  state.Validate();
+  Restore(state);
 }
 
-void Chip8::Cancel() { _cancelled = true; }
\ No newline at end of file
+void Chip8::Restore(const SaveState &state) {
+  const auto &payload = state.payload;
+  if (payload.stackPointer > STACK_SIZE) {
+    throw std::runtime_error("Save state has an invalid stack pointer");
+  }
+  _memory.Restore(payload.memory);
+  _screen->Load(payload.framebuffer, payload.highResolution != 0,
+                payload.planes);
+  _rng.Load(payload.rng);
+  _stack = payload.stack;
+  _flags = payload.flags;
+  std::copy(payload.registers.begin(), payload.registers.end(),
+            _registers.begin());
+  _programCounter = payload.programCounter;
+  _index = payload.index;
+  _stackPointer = payload.stackPointer;
+  _delayTimer = payload.delayTimer;
+  _soundTimer = payload.soundTimer;
+  // an FX0A in progress simply runs again
+  _keyPress.reset();
+}
\ No newline at end of file
@@ -1,27 +1,38 @@
 #include "Keyboard.hpp"
 #include <cassert>
 #include <cstdio>
+#include <mutex>
 #include <unistd.h>
 
 // NOLINTBEGIN(*-array-index)
 bool Keyboard::IsKeyPressed(std::size_t key) const {
-  assert(key < _keyboard.size());
-  return _keyboard[key];
+  assert(key < _keyboard.value.size());
+  return _keyboard.value[key];
 }
 
 void Keyboard::SetKeyPressed(std::size_t key, bool isPressed) {
-  assert(key < _keyboard.size());
+  assert(key < _keyboard.value.size());
   if (isPressed) {
+    const std::scoped_lock lock(_requestsMutex);
     for (auto &request : _keyPressRequests) {
       request.set_value(key);
     }
     _keyPressRequests.clear();
   }
-  _keyboard[key] = isPressed;
+  _keyboard.value[key] = isPressed;
 }
 // NOLINTEND(*-array-index)
 
 std::future<std::size_t> Keyboard::GetNextKeyPress() {
+  const std::scoped_lock lock(_requestsMutex);
   _keyPressRequests.emplace_back();
   return _keyPressRequests.back().get_future();
-}
\ No newline at end of file
+}
+
+void Keyboard::Reset() {
+  const std::scoped_lock lock(_requestsMutex);
+  _keyPressRequests.clear();
+  for (auto &key : _keyboard.value) {
+    key = false;
+  }
+}
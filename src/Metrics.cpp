@@ -0,0 +1,73 @@
+#include "Metrics.hpp"
+#include "Threading.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <sstream>
+
+namespace {
+double Seconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+} // namespace
+
+void MetricsRegistry::Add(std::string name, std::string help,
+                          const Counter &counter) {
+  const std::scoped_lock lock{_mutex};
+  _entries.push_back({std::move(name), std::move(help), &counter});
+}
+
+void MetricsRegistry::Add(std::string name, std::string help,
+                          const Gauge &gauge) {
+  const std::scoped_lock lock{_mutex};
+  _entries.push_back({std::move(name), std::move(help), &gauge});
+}
+
+void MetricsRegistry::Add(std::string name, std::string help,
+                          Computed gauge) {
+  const std::scoped_lock lock{_mutex};
+  _entries.push_back({std::move(name), std::move(help), std::move(gauge)});
+}
+
+void MetricsRegistry::Add(std::string name, std::string help,
+                          const LatencyHistogram &histogram) {
+  const std::scoped_lock lock{_mutex};
+  _entries.push_back({std::move(name), std::move(help), &histogram});
+}
+
+void MetricsRegistry::WritePrometheus(std::ostream &out) const {
+  std::ostringstream text;
+  text.precision(std::numeric_limits<double>::digits10);
+  const std::scoped_lock lock{_mutex};
+  for (const auto &entry : _entries) {
+    text << "# HELP " << entry.name << ' ' << entry.help << '\n';
+    if (const auto *counter = std::get_if<const Counter *>(&entry.metric)) {
+      text << "# TYPE " << entry.name << " counter\n"
+           << entry.name << ' ' << (*counter)->Value() << '\n';
+    } else if (const auto *gauge = std::get_if<const Gauge *>(&entry.metric)) {
+      text << "# TYPE " << entry.name << " gauge\n"
+           << entry.name << ' ' << (*gauge)->Value() << '\n';
+    } else if (const auto *computed = std::get_if<Computed>(&entry.metric)) {
+      text << "# TYPE " << entry.name << " gauge\n"
+           << entry.name << ' ' << (*computed)() << '\n';
+    } else {
+      const auto &histogram =
+        *std::get<const LatencyHistogram *>(entry.metric);
+      text << "# TYPE " << entry.name << " histogram\n";
+      std::uint64_t count = 0;
+      for (const auto bound : LATENCY_BOUNDS_US) {
+        const std::chrono::microseconds boundDuration{bound};
+        count = histogram.CountAtMost(boundDuration);
+        text << entry.name << "_bucket{le=\"" << Seconds(boundDuration)
+             << "\"} " << count << '\n';
+      }
+      // the writer may have recorded more samples since the buckets were
+      // read; the total must not be below any bucket
+      count = std::max(count, histogram.Count());
+      text << entry.name << "_bucket{le=\"+Inf\"} " << count << '\n'
+           << entry.name << "_sum " << Seconds(histogram.Total()) << '\n'
+           << entry.name << "_count " << count << '\n';
+    }
+  }
+  out << text.str();
+}
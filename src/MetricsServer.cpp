@@ -0,0 +1,177 @@
+#include "MetricsServer.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+constexpr int POLL_INTERVAL_MS = 100;
+
+std::optional<std::string> ReadEnvironment(const std::string &name) {
+  const char *value = std::getenv(name.c_str());
+  if (value == nullptr || *value == '\0') {
+    return std::nullopt;
+  }
+  return value;
+}
+
+bool WriteAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const auto written = write(fd, data.data(), data.size());
+    if (written <= 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<std::size_t>(written));
+  }
+  return true;
+}
+} // namespace
+
+MetricsServer::Options
+MetricsServer::Options::FromEnvironment(const std::string &prefix) {
+  Options options;
+  options.socketPath = ReadEnvironment(prefix + "_SOCKET");
+  options.filePath = ReadEnvironment(prefix + "_FILE");
+  if (const auto interval = ReadEnvironment(prefix + "_INTERVAL_MS")) {
+    std::size_t parsed = 0;
+    const auto milliseconds = std::stol(*interval, &parsed);
+    if (parsed != interval->size() || milliseconds <= 0) {
+      throw std::invalid_argument("Invalid " + prefix +
+                                  "_INTERVAL_MS: " + *interval);
+    }
+    options.interval = std::chrono::milliseconds{milliseconds};
+  }
+  return options;
+}
+
+MetricsServer::MetricsServer(const MetricsRegistry *registry, Options options)
+    : _registry(registry), _options(std::move(options)) {
+  if (_options.socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const auto pathString = _options.socketPath->string();
+    if (pathString.size() >= sizeof(address.sun_path)) {
+      throw std::runtime_error("Metrics socket path too long: " + pathString);
+    }
+    std::copy(pathString.begin(), pathString.end(), &address.sun_path[0]);
+    std::filesystem::remove(*_options.socketPath);
+
+    _listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_listener < 0 ||
+        // NOLINTNEXTLINE(*-reinterpret-cast)
+        bind(_listener, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+        listen(_listener, SOMAXCONN) != 0) {
+      const std::string error = std::strerror(errno);
+      if (_listener >= 0) {
+        close(_listener);
+      }
+      throw std::runtime_error("Cannot listen on " + pathString + ": " +
+                               error);
+    }
+  }
+  _thread = std::thread([this]() { Serve(); });
+}
+
+MetricsServer::~MetricsServer() {
+  _stopping = true;
+  _thread.join();
+  if (_listener >= 0) {
+    close(_listener);
+    std::filesystem::remove(*_options.socketPath);
+  }
+}
+
+void MetricsServer::Serve() {
+  using Clock = std::chrono::steady_clock;
+  auto nextWrite = Clock::now();
+  while (!_stopping) {
+    if (_options.filePath && Clock::now() >= nextWrite) {
+      WriteFile();
+      nextWrite = std::max(nextWrite + _options.interval, Clock::now());
+    }
+    auto timeout = std::chrono::milliseconds{POLL_INTERVAL_MS};
+    if (_options.filePath) {
+      timeout = std::min(timeout, std::chrono::ceil<std::chrono::milliseconds>(
+                                    nextWrite - Clock::now()));
+    }
+    timeout = std::max(timeout, std::chrono::milliseconds{0});
+    if (_listener < 0) {
+      std::this_thread::sleep_for(timeout);
+      continue;
+    }
+    pollfd listener{_listener, POLLIN, 0};
+    if (poll(&listener, 1, static_cast<int>(timeout.count())) <= 0) {
+      continue;
+    }
+    const int client = accept(_listener, nullptr, nullptr);
+    if (client >= 0) {
+      ServeClient(client);
+      close(client);
+    }
+  }
+  // leave the final values behind for whoever reads the file after exit
+  if (_options.filePath) {
+    WriteFile();
+  }
+}
+
+void MetricsServer::ServeClient(int client) const {
+  // give an HTTP client a moment to send its request line; anything else
+  // gets the bare snapshot
+  constexpr static std::size_t READ_SIZE = 1024;
+  std::array<char, READ_SIZE> request{};
+  ssize_t received = 0;
+  pollfd connection{client, POLLIN, 0};
+  if (poll(&connection, 1, POLL_INTERVAL_MS) > 0) {
+    received = read(client, request.data(), request.size());
+  }
+  const bool http = received > 0 &&
+                    std::string_view(request.data(),
+                                     static_cast<std::size_t>(received))
+                      .starts_with("GET ");
+
+  std::ostringstream body;
+  _registry->WritePrometheus(body);
+  const auto text = body.str();
+  if (http) {
+    const auto header = "HTTP/1.0 200 OK\r\n"
+                        "Content-Type: text/plain; version=0.0.4\r\n"
+                        "Content-Length: " +
+                        std::to_string(text.size()) + "\r\n\r\n";
+    if (!WriteAll(client, header)) {
+      return;
+    }
+  }
+  WriteAll(client, text);
+}
+
+void MetricsServer::WriteFile() const {
+  auto temporary = *_options.filePath;
+  temporary += ".tmp";
+  {
+    std::ofstream out{temporary, std::ios::trunc};
+    _registry->WritePrometheus(out);
+    if (!out) {
+      std::cerr << "Cannot write metrics to " << temporary << '\n';
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, *_options.filePath, error);
+  if (error) {
+    std::cerr << "Cannot write metrics to " << *_options.filePath << ": "
+              << error.message() << '\n';
+  }
+}
@@ -0,0 +1,142 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+Profiler::Profiler() { Reset(); }
+
+void Profiler::Reset() {
+  _instructions = 0;
+  _opcodeCounts = {};
+  _pcCounts.assign(ADDRESS_SPACE, 0);
+  _nodes.clear();
+  _nodes.push_back({ROOT, 0, 0, {}});
+  _currentNode = ROOT;
+}
+
+void Profiler::OnCall(std::size_t target) {
+  // NOLINTBEGIN(*-array-index)
+  auto &children = _nodes[_currentNode].children;
+  const auto existing = std::find_if(
+    children.begin(), children.end(),
+    [this, target](std::size_t child) { return _nodes[child].target == target; });
+  if (existing != children.end()) {
+    _currentNode = *existing;
+    return;
+  }
+  const auto child = _nodes.size();
+  children.push_back(child);
+  _nodes.push_back({_currentNode, target, 0, {}});
+  _currentNode = child;
+  // NOLINTEND(*-array-index)
+}
+
+void Profiler::OnReturn() {
+  // a return at the top level underflows the interpreter's stack; stay at
+  // the root so the profile stays consistent
+  // NOLINTNEXTLINE(*-array-index)
+  _currentNode = _nodes[_currentNode].parent;
+}
+
+std::string Profiler::ClassName(std::size_t classIndex) {
+  // NOLINTBEGIN(*-magic-numbers)
+  const auto family = classIndex >> 8;
+  const auto selector = classIndex & 0xFF;
+  std::stringstream name;
+  name << std::hex << std::uppercase;
+  switch (family) {
+  case 0x0:
+    name << "00" << std::setw(2) << std::setfill('0') << selector;
+    break;
+  case 0x5:
+  case 0x8:
+    name << family << "XY" << selector;
+    break;
+  case 0xE:
+  case 0xF:
+    name << family << 'X' << std::setw(2) << std::setfill('0') << selector;
+    break;
+  case 0x1:
+  case 0x2:
+  case 0xA:
+  case 0xB:
+    name << family << "NNN";
+    break;
+  case 0x9:
+    name << "9XY0";
+    break;
+  case 0xD:
+    name << "DXYN";
+    break;
+  default:
+    name << family << "XKK";
+    break;
+  }
+  return name.str();
+  // NOLINTEND(*-magic-numbers)
+}
+
+std::string Profiler::StackName(std::size_t node) const {
+  std::vector<std::size_t> frames;
+  for (auto current = node; current != ROOT; current = _nodes[current].parent) {
+    frames.push_back(_nodes[current].target);
+  }
+  std::stringstream name;
+  name << "rom";
+  name << std::hex << std::uppercase;
+  for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame) {
+    name << ";0x" << *frame;
+  }
+  return name.str();
+}
+
+void Profiler::WriteJson(std::ostream &out) const {
+  out << "{\"enabled\":true,\"instructions\":" << _instructions;
+  out << ",\"opcodes\":{";
+  bool first = true;
+  for (std::size_t classIndex = 0; classIndex < _opcodeCounts.size();
+       ++classIndex) {
+    // NOLINTNEXTLINE(*-array-index)
+    const auto count = _opcodeCounts[classIndex];
+    if (count == 0) {
+      continue;
+    }
+    out << (first ? "" : ",") << '"' << ClassName(classIndex) << "\":" << count;
+    first = false;
+  }
+  out << "},\"pcs\":{";
+  first = true;
+  for (std::size_t pc = 0; pc < _pcCounts.size(); ++pc) {
+    // NOLINTNEXTLINE(*-array-index)
+    const auto count = _pcCounts[pc];
+    if (count == 0) {
+      continue;
+    }
+    out << (first ? "" : ",") << "\"0x" << std::hex << std::uppercase << pc
+        << std::dec << "\":" << count;
+    first = false;
+  }
+  out << "},\"stacks\":[";
+  first = true;
+  for (std::size_t node = 0; node < _nodes.size(); ++node) {
+    // NOLINTNEXTLINE(*-array-index)
+    const auto cycles = _nodes[node].cycles;
+    if (cycles == 0) {
+      continue;
+    }
+    out << (first ? "" : ",") << "{\"stack\":\"" << StackName(node)
+        << "\",\"cycles\":" << cycles << '}';
+    first = false;
+  }
+  out << "]}\n";
+}
+
+void Profiler::WriteFoldedStacks(std::ostream &out) const {
+  for (std::size_t node = 0; node < _nodes.size(); ++node) {
+    // NOLINTNEXTLINE(*-array-index)
+    const auto cycles = _nodes[node].cycles;
+    if (cycles != 0) {
+      out << StackName(node) << ' ' << cycles << '\n';
+    }
+  }
+}
@@ -1,6 +1,48 @@
 #include "Random.hpp"
+#include <cstring>
+#include <stdexcept>
 
-RandomNumberGenerator::RandomNumberGenerator(int min, int max, int seed)
-    : _rng(seed), _dist(min, max) {}
+namespace {
+/**
+ * @brief SplitMix64's finalizer: a bijection that scatters nearby inputs
+ */
+constexpr std::uint64_t Mix(std::uint64_t value) {
+  // NOLINTBEGIN(*-magic-numbers)
+  value += 0x9E3779B97F4A7C15;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+  return value ^ (value >> 31);
+  // NOLINTEND(*-magic-numbers)
+}
+} // namespace
 
-int RandomNumberGenerator::Generate() { return _dist(_rng); }
\ No newline at end of file
+// Squares needs a key with well-mixed bits; consecutive instance ids of one
+// seed must not give related keys. The key is odd so that counter * key
+// visits every value
+RandomNumberGenerator::RandomNumberGenerator(std::uint64_t seed,
+                                             std::uint64_t instance)
+    : _key(Mix(seed ^ Mix(instance)) | 1U) {}
+
+void RandomNumberGenerator::GenerateBatch(
+  std::span<const std::uint64_t> keys, std::span<const std::uint64_t> counters,
+  std::span<std::uint32_t> out) {
+  if (keys.size() != out.size() || counters.size() != out.size()) {
+    throw std::invalid_argument("GenerateBatch spans differ in length");
+  }
+  for (std::size_t lane = 0; lane < out.size(); ++lane) {
+    // NOLINTNEXTLINE(*-array-index)
+    out[lane] = Squares32(counters[lane], keys[lane]);
+  }
+}
+
+void RandomNumberGenerator::Save(
+  std::span<std::uint8_t, STATE_BYTES> out) const {
+  std::memcpy(out.data(), &_key, sizeof(_key));
+  std::memcpy(out.subspan(sizeof(_key)).data(), &_counter, sizeof(_counter));
+}
+
+void RandomNumberGenerator::Load(
+  std::span<const std::uint8_t, STATE_BYTES> in) {
+  std::memcpy(&_key, in.data(), sizeof(_key));
+  std::memcpy(&_counter, in.subspan(sizeof(_key)).data(), sizeof(_counter));
+}
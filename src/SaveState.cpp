@@ -0,0 +1,66 @@
+#include "SaveState.hpp"
+#include "StateHash.hpp"
+#include <fstream>
+#include <stdexcept>
+
+void SaveState::Seal() {
+  header = {};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.headerBytes = sizeof(SaveStateHeader);
+  header.payloadBytes = sizeof(SaveStatePayload);
+  header.checksum = Checksum();
+}
+
+std::uint64_t SaveState::Checksum() const {
+  StateHasher hasher;
+  hasher.AddBytes(std::as_bytes(std::span(&payload, 1)));
+  return hasher.Value();
+}
+
+void SaveState::Validate() const {
+  if (header.magic != MAGIC) {
+    throw std::runtime_error("Not a save state");
+  }
+  if (header.version != VERSION) {
+    throw std::runtime_error("Unsupported save state version: " +
+                             std::to_string(header.version));
+  }
+  if (header.headerBytes != sizeof(SaveStateHeader) ||
+      header.payloadBytes != sizeof(SaveStatePayload)) {
+    throw std::runtime_error("Save state has an unexpected layout");
+  }
+  if (header.checksum != Checksum()) {
+    throw std::runtime_error("Save state checksum mismatch");
+  }
+}
+
+void SaveState::WriteToFile(const std::filesystem::path &path) const {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  // NOLINTNEXTLINE(*-reinterpret-cast)
+  file.write(reinterpret_cast<const char *>(this), sizeof(SaveState));
+  if (!file) {
+    throw std::runtime_error("Failed to write save state: " + path.string());
+  }
+}
+
+void SaveState::ReadFromFile(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  // NOLINTNEXTLINE(*-reinterpret-cast)
+  if (!file.read(reinterpret_cast<char *>(this), sizeof(SaveState))) {
+    throw std::runtime_error("Failed to read save state: " + path.string());
+  }
+  Validate();
+}
+
+const SaveState &SaveState::FromBytes(std::span<const std::byte> bytes) {
+  if (bytes.size() < sizeof(SaveState) ||
+      reinterpret_cast<std::uintptr_t>(bytes.data()) % alignof(SaveState) !=
+        0) {
+    throw std::runtime_error("Buffer cannot hold a save state");
+  }
+  // NOLINTNEXTLINE(*-reinterpret-cast)
+  const auto &state = *reinterpret_cast<const SaveState *>(bytes.data());
+  state.Validate();
+  return state;
+}
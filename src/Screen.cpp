@@ -1,12 +1,48 @@
 #include "Screen.hpp"
 #include "Constants.hpp"
+#include "StateHash.hpp"
 #include "Types.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <iostream>
 
-void Screen::Clear() {
-  for (auto &pixel : _pixels) {
-    pixel = false;
+namespace {
+constexpr std::size_t WORD_BITS = 64;
+
+/**
+ * @brief sprite bytes have their leftmost pixel in the most significant bit,
+ * rows in the least significant
+ */
+constexpr auto REVERSED_BYTES = []() {
+  std::array<std::uint8_t, Constants::MAX_BYTE + 1> reversed{};
+  for (std::size_t value = 0; value < reversed.size(); ++value) {
+    for (unsigned int bit = 0; bit < Constants::BITS_PER_BYTE; ++bit) {
+      if ((value >> bit & 1U) != 0) {
+        reversed.at(value) |= static_cast<std::uint8_t>(
+          1U << (Constants::BITS_PER_BYTE - 1 - bit));
+      }
+    }
   }
+  return reversed;
+}();
+
+/**
+ * @brief `bits` (leftmost pixel in bit 0) moved to start at column `x`, which
+ * must be below HIRES_WIDTH. Pixels past the last column are dropped
+ */
+Screen::Row PlaceAt(std::uint64_t bits, std::size_t x) {
+  if (x >= WORD_BITS) {
+    return {0, bits << (x - WORD_BITS)};
+  }
+  return {bits << x, x == 0 ? 0 : bits >> (WORD_BITS - x)};
+}
+} // namespace
+
+void Screen::Clear() {
+  ForEachSelected([](std::span<Row> rows) { std::ranges::fill(rows, Row{}); });
+  _staleRows = ALL_ROWS;
+  NotifyUpdate();
 }
 
 void Screen::ClearStdout() { std::cout << "\033[2J\033[1;1H"; }
@@ -15,60 +51,220 @@ void Screen::Display() {
   static constexpr auto BLOCK = "\u2588";
   static constexpr auto BLANK = " ";
   ClearStdout();
-  for (std::size_t y = 0; y < HEIGHT; ++y) {
-    for (std::size_t x = 0; x < WIDTH; ++x) {
-      std::cout << (PixelAt(x, y) ? BLOCK : BLANK);
+  for (std::size_t y = 0; y < Height(); ++y) {
+    for (std::size_t x = 0; x < Width(); ++x) {
+      std::cout << (ColorAt(x, y) != 0 ? BLOCK : BLANK);
     }
     std::cout << '\n';
   }
   std::cout << std::flush;
 }
 
-bool Screen::Draw(Byte x, Byte y, const std::span<Byte> sprite) {
-  constexpr static unsigned int MSB = 1 << (Constants::BITS_PER_BYTE - 1);
-  const auto xBase = x % WIDTH;
-  const auto yBase = y % HEIGHT;
-  bool changed = false;
-  bool collision = false;
-  for (std::size_t yOffset = 0; yOffset < sprite.size(); ++yOffset) {
-    const auto yCoord = yBase + yOffset;
-    if (yCoord >= HEIGHT) {
-      break;
+void Screen::SelectPlanes(unsigned int mask) {
+  _selected = mask & (NUM_COLORS - 1);
+}
+
+std::size_t Screen::SelectedPlaneCount() const {
+  return static_cast<std::size_t>(std::popcount(_selected));
+}
+
+bool Screen::Draw(Byte x, Byte y, std::span<const std::uint8_t> sprite) {
+  constexpr static std::size_t MAX_ROWS = 16;
+  // NOLINTNEXTLINE(*-member-init)
+  std::array<std::uint64_t, MAX_ROWS * NUM_PLANES> rows;
+  const auto planes = std::max<std::size_t>(SelectedPlaneCount(), 1);
+  const auto stride = sprite.size() / planes;
+  const auto count = std::min(stride, MAX_ROWS);
+  for (std::size_t plane = 0; plane < planes; ++plane) {
+    for (std::size_t row = 0; row < count; ++row) {
+      // NOLINTNEXTLINE(*-array-index)
+      rows[plane * count + row] = REVERSED_BYTES[sprite[plane * stride + row]];
     }
-    const auto spriteRow = sprite[yOffset];
-    for (unsigned int bitNum = 0; bitNum < Constants::BITS_PER_BYTE; ++bitNum) {
-      const auto xCoord = xBase + bitNum;
-      if (xCoord >= WIDTH) {
-        break;
-      }
-      auto &pixel = PixelAt(xCoord, yCoord);
-      const auto spriteBitSet = static_cast<bool>((MSB >> bitNum) & spriteRow);
-      const auto oldPixel = pixel;
-      pixel ^= static_cast<int>(spriteBitSet);
-      if (oldPixel != pixel) {
-        changed = true;
-        const bool pixelTurnedOff = !pixel;
-        collision = collision || pixelTurnedOff;
-      }
+  }
+  return DrawRows(x, y, std::span(rows).first(planes * count), count);
+}
+
+bool Screen::DrawLarge(Byte x, Byte y, std::span<const std::uint8_t> sprite) {
+  constexpr static std::size_t ROWS = 16;
+  // NOLINTNEXTLINE(*-member-init)
+  std::array<std::uint64_t, ROWS * NUM_PLANES> rows;
+  const auto planes = std::max<std::size_t>(SelectedPlaneCount(), 1);
+  const auto stride = sprite.size() / planes;
+  const auto count = std::min(stride / 2, ROWS);
+  for (std::size_t plane = 0; plane < planes; ++plane) {
+    for (std::size_t row = 0; row < count; ++row) {
+      const auto source = plane * stride + 2 * row;
+      // NOLINTBEGIN(*-array-index)
+      rows[plane * count + row] =
+        REVERSED_BYTES[sprite[source]] |
+        static_cast<std::uint64_t>(REVERSED_BYTES[sprite[source + 1]])
+          << Constants::BITS_PER_BYTE;
+      // NOLINTEND(*-array-index)
     }
   }
-  if (changed) {
+  return DrawRows(x, y, std::span(rows).first(planes * count), count);
+}
+
+bool Screen::DrawRows(Byte x, Byte y, std::span<const std::uint64_t> sprite,
+                      std::size_t rowsPerPlane) {
+  // both resolutions are powers of two
+  const auto xBase = static_cast<std::size_t>(x) & (Width() - 1);
+  const auto yBase = static_cast<std::size_t>(y) & (Height() - 1);
+  const auto highMask = RowMask()[1];
+  const auto rows = std::min(rowsPerPlane, Height() - yBase);
+  _draws.Add();
+  std::uint64_t changed = 0;
+  std::uint64_t collision = 0;
+  std::size_t block = 0;
+  for (auto planes = _selected; planes != 0; planes &= planes - 1) {
+    // NOLINTBEGIN(*-array-index)
+    auto &plane = _planes[static_cast<std::size_t>(std::countr_zero(planes))];
+    for (std::size_t offset = 0; offset < rows; ++offset) {
+      auto placed = PlaceAt(sprite[block + offset], xBase);
+      placed[1] &= highMask;
+      auto &row = plane[yBase + offset];
+      collision |= (row[0] & placed[0]) | (row[1] & placed[1]);
+      changed |= placed[0] | placed[1];
+      row[0] ^= placed[0];
+      row[1] ^= placed[1];
+    }
+    // NOLINTEND(*-array-index)
+    block += rowsPerPlane;
+  }
+  if (changed != 0) {
+    _staleRows |= (rows < WORD_BITS ? (std::uint64_t{1} << rows) - 1 : ALL_ROWS)
+                  << yBase;
     NotifyUpdate();
   }
-  return collision;
+  return collision != 0;
+}
+
+void Screen::ScrollDown(std::size_t rows) {
+  rows = std::min(rows, Height());
+  ForEachSelected([rows](std::span<Row> plane) {
+    const auto shift = static_cast<std::ptrdiff_t>(rows);
+    std::move_backward(plane.begin(), plane.end() - shift, plane.end());
+    std::fill(plane.begin(), plane.begin() + shift, Row{});
+  });
+  _staleRows = ALL_ROWS;
+  NotifyUpdate();
+}
+
+void Screen::ScrollUp(std::size_t rows) {
+  rows = std::min(rows, Height());
+  ForEachSelected([rows](std::span<Row> plane) {
+    const auto shift = static_cast<std::ptrdiff_t>(rows);
+    std::move(plane.begin() + shift, plane.end(), plane.begin());
+    std::fill(plane.end() - shift, plane.end(), Row{});
+  });
+  _staleRows = ALL_ROWS;
+  NotifyUpdate();
+}
+
+void Screen::ScrollLeft() {
+  constexpr static auto CARRY = WORD_BITS - SCROLL_PIXELS;
+  ForEachSelected([](std::span<Row> plane) {
+    for (auto &row : plane) {
+      row[0] = row[0] >> SCROLL_PIXELS | row[1] << CARRY;
+      row[1] >>= SCROLL_PIXELS;
+    }
+  });
+  _staleRows = ALL_ROWS;
+  NotifyUpdate();
+}
+
+void Screen::ScrollRight() {
+  constexpr static auto CARRY = WORD_BITS - SCROLL_PIXELS;
+  const auto mask = RowMask();
+  ForEachSelected([mask](std::span<Row> plane) {
+    for (auto &row : plane) {
+      row[1] = (row[1] << SCROLL_PIXELS | row[0] >> CARRY) & mask[1];
+      row[0] = row[0] << SCROLL_PIXELS & mask[0];
+    }
+  });
+  _staleRows = ALL_ROWS;
+  NotifyUpdate();
+}
+
+void Screen::SetHighResolution(bool enabled) {
+  _highResolution = enabled;
+  for (auto &plane : _planes) {
+    plane.fill({});
+  }
+  _staleRows = ALL_ROWS;
+  NotifyUpdate();
+}
+
+std::uint8_t Screen::ColorAt(std::size_t x, std::size_t y) const {
+  unsigned int color = 0;
+  for (std::size_t plane = 0; plane < NUM_PLANES; ++plane) {
+    const auto word = _planes.at(plane).at(y).at(x / WORD_BITS);
+    color |= static_cast<unsigned int>(word >> (x % WORD_BITS) & 1U) << plane;
+  }
+  return static_cast<std::uint8_t>(color);
+}
+
+Screen::Row Screen::RowMask() const {
+  return {~std::uint64_t{0}, _highResolution ? ~std::uint64_t{0} : 0};
+}
+
+void Screen::Save(std::span<std::uint8_t, FRAMEBUFFER_BYTES> out) const {
+  static_assert(sizeof(_planes) == FRAMEBUFFER_BYTES);
+  std::memcpy(out.data(), _planes.data(), FRAMEBUFFER_BYTES);
+}
+
+void Screen::Load(std::span<const std::uint8_t, FRAMEBUFFER_BYTES> in,
+                  bool highResolution, unsigned int selectedPlanes) {
+  _highResolution = highResolution;
+  SelectPlanes(selectedPlanes);
+  std::memcpy(_planes.data(), in.data(), FRAMEBUFFER_BYTES);
+  // keep the invariant that pixels outside the current mode are clear
+  const auto mask = RowMask();
+  for (auto &plane : _planes) {
+    for (std::size_t y = 0; y < plane.size(); ++y) {
+      for (std::size_t word = 0; word < mask.size(); ++word) {
+        plane.at(y).at(word) &= y < Height() ? mask.at(word) : 0;
+      }
+    }
+  }
+  _staleRows = ALL_ROWS;
+  NotifyUpdate();
+}
+
+std::uint64_t Screen::Hash() {
+  for (; _staleRows != 0; _staleRows &= _staleRows - 1) {
+    const auto y = static_cast<std::size_t>(std::countr_zero(_staleRows));
+    StateHasher hasher{y};
+    for (const auto &plane : _planes) {
+      // NOLINTBEGIN(*-array-index)
+      hasher.Add(plane[y][0]);
+      hasher.Add(plane[y][1]);
+      // NOLINTEND(*-array-index)
+    }
+    // NOLINTNEXTLINE(*-array-index)
+    auto &cached = _rowHashes[y];
+    _rowsHash ^= cached ^ hasher.Value();
+    cached = hasher.Value();
+  }
+  StateHasher hasher{_rowsHash};
+  hasher.Add(static_cast<std::uint64_t>(_highResolution) |
+             static_cast<std::uint64_t>(_selected) << 1U);
+  return hasher.Value();
 }
 
 void Screen::RegisterUpdateCallback(UpdateCallback callback) {
   _updateCallbacks.emplace_back(std::move(callback));
 }
 
+void Screen::RegisterMetrics(MetricsRegistry &registry) const {
+  registry.Add("chip8_sprites_drawn_total", "DXYN sprite draws", _draws);
+  registry.Add("chip8_screen_updates_total",
+               "Framebuffer changes handed to listeners", _updates);
+}
+
 void Screen::NotifyUpdate() {
+  _updates.Add();
   for (auto &callback : _updateCallbacks) {
-    callback(_pixels);
+    callback(*this);
   }
 }
-
-Screen::Pixel &Screen::PixelAt(std::size_t x, std::size_t y) {
-  // NOLINTNEXTLINE
-  return _pixels.at(WIDTH * y + x);
-}
\ No newline at end of file
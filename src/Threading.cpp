@@ -0,0 +1,156 @@
+#include "Threading.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace {
+std::optional<int> ReadEnvironment(const std::string &name) {
+  const char *value = std::getenv(name.c_str());
+  if (value == nullptr || *value == '\0') {
+    return std::nullopt;
+  }
+  std::size_t parsed = 0;
+  const auto result = std::stoi(value, &parsed);
+  if (value[parsed] != '\0') {
+    throw std::invalid_argument("Invalid " + name + ": " + value);
+  }
+  return result;
+}
+
+double Microseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+} // namespace
+
+ThreadOptions ThreadOptions::FromEnvironment(std::string_view prefix) {
+  const std::string base{prefix};
+  return {ReadEnvironment(base + "_CPU"),
+          ReadEnvironment(base + "_FIFO_PRIORITY")};
+}
+
+void ApplyThreadOptions(const ThreadOptions &options) {
+  const auto self = pthread_self();
+  if (options.cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(*options.cpu, &cpus);
+    if (const auto error = pthread_setaffinity_np(self, sizeof(cpus), &cpus);
+        error != 0) {
+      throw std::system_error(error, std::generic_category(),
+                              "pthread_setaffinity_np");
+    }
+  }
+  if (options.fifoPriority) {
+    sched_param param{};
+    param.sched_priority = *options.fifoPriority;
+    if (const auto error = pthread_setschedparam(self, SCHED_FIFO, &param);
+        error != 0) {
+      throw std::system_error(error, std::generic_category(),
+                              "pthread_setschedparam(SCHED_FIFO)");
+    }
+  }
+}
+
+std::chrono::nanoseconds ThreadCpuTime() {
+  timespec time{};
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+    throw std::system_error(errno, std::generic_category(), "clock_gettime");
+  }
+  return std::chrono::seconds{time.tv_sec} +
+         std::chrono::nanoseconds{time.tv_nsec};
+}
+
+void LatencyHistogram::Record(Duration sample) {
+  constexpr static auto RELAXED = std::memory_order_relaxed;
+  sample = std::max(sample, Duration{});
+  const auto bucket =
+    std::min(static_cast<std::size_t>(sample / BUCKET_WIDTH), NUM_BUCKETS - 1);
+  // single writer: see Metrics.hpp
+  // NOLINTNEXTLINE(*-array-index)
+  _buckets[bucket].store(_buckets[bucket].load(RELAXED) + 1, RELAXED);
+  _count.store(_count.load(RELAXED) + 1, RELAXED);
+  _total.store(_total.load(RELAXED) + sample.count(), RELAXED);
+  _max.store(std::max(_max.load(RELAXED), sample.count()), RELAXED);
+}
+
+LatencyHistogram::Duration LatencyHistogram::Mean() const {
+  const auto count = Count();
+  return count == 0 ? Duration{} : Total() / static_cast<Duration::rep>(count);
+}
+
+LatencyHistogram::Duration LatencyHistogram::Quantile(double quantile) const {
+  const auto target =
+    static_cast<std::uint64_t>(quantile * static_cast<double>(Count()));
+  std::uint64_t seen = 0;
+  for (std::size_t bucket = 0; bucket < NUM_BUCKETS; ++bucket) {
+    // NOLINTNEXTLINE(*-array-index)
+    seen += _buckets[bucket].load(std::memory_order_relaxed);
+    if (seen > target) {
+      return std::min(BUCKET_WIDTH * static_cast<Duration::rep>(bucket + 1),
+                      Max());
+    }
+  }
+  return Max();
+}
+
+std::uint64_t LatencyHistogram::CountAtMost(Duration bound) const {
+  const auto buckets =
+    std::min(static_cast<std::size_t>(bound / BUCKET_WIDTH), NUM_BUCKETS - 1);
+  std::uint64_t count = 0;
+  for (std::size_t bucket = 0; bucket < buckets; ++bucket) {
+    // NOLINTNEXTLINE(*-array-index)
+    count += _buckets[bucket].load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+FramePacer::FramePacer(Clock::duration period)
+    : _period(period), _start(Clock::now()), _deadline(_start),
+      _startCpu(ThreadCpuTime()), _lastCpu(_startCpu), _lastWake(_start) {}
+
+void FramePacer::Wait() {
+  _deadline += _period;
+  const auto now = Clock::now();
+  if (now > _deadline) {
+    _missed.Add();
+    if (now - _deadline > MAX_LAG * _period) {
+      _deadline = now;
+    }
+  }
+  std::this_thread::sleep_until(_deadline);
+  _lastWake = Clock::now();
+  _lastCpu = ThreadCpuTime();
+  _lateness.Record(_lastWake - _deadline);
+}
+
+void FramePacer::WriteSummary(std::ostream &out, std::string_view name) const {
+  const auto wall = _lastWake - _start;
+  const auto cpu = _lastCpu - _startCpu;
+  const auto cpuShare =
+    wall.count() > 0 ? 100.0 * static_cast<double>(cpu.count()) /
+                         static_cast<double>(wall.count())
+                     : 0.0;
+  out << std::fixed << std::setprecision(1) << name
+      << ": frames=" << _lateness.Count() << " missed=" << Missed()
+      << " lateness_us mean=" << Microseconds(_lateness.Mean())
+      << " p99=" << Microseconds(_lateness.Quantile(0.99))
+      << " max=" << Microseconds(_lateness.Max()) << " cpu=" << cpuShare
+      << "%\n";
+}
+
+void FramePacer::RegisterMetrics(MetricsRegistry &registry,
+                                 const std::string &prefix) const {
+  registry.Add(prefix + "_wakeup_lateness_seconds",
+               "How late the thread woke for each frame deadline", _lateness);
+  registry.Add(prefix + "_missed_deadlines_total",
+               "Frame deadlines that had passed before the frame finished",
+               _missed);
+}
@@ -18,7 +18,9 @@ void Timer::RegisterCallback(Callback callback) noexcept {
 }
 
 void Timer::Decrement() {
-  --_remainingTicks;
+  if (_remainingTicks > 0) {
+    --_remainingTicks;
+  }
   for (const auto &callback : _callbacks) {
     callback(_remainingTicks);
   }
@@ -28,14 +30,17 @@ void Timer::Decrement() {
 }
 
 void Timer::Tick(TimePoint currentTime) {
-  if (_lastTick.has_value()) {
-    const auto diff = *_lastTick - currentTime;
-    if (diff >= _period) {
+  if (!_lastTick.has_value()) {
+    _lastTick = currentTime;
+    return;
+  }
+  // advance by whole periods so that late ticks do not accumulate drift
+  while (currentTime - *_lastTick >= _period) {
+    *_lastTick += _period;
+    if (_remainingTicks > 0 || _shouldRepeat) {
       Decrement();
-      _lastTick = currentTime;
     }
   }
-  _lastTick = currentTime;
 }
 
 void Timer::SetTicks(unsigned int ticks) noexcept { _remainingTicks = ticks; }
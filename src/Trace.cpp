@@ -0,0 +1,49 @@
+#include "Trace.hpp"
+#include <iomanip>
+#include <stdexcept>
+
+static_assert(std::endian::native == std::endian::little,
+              "trace files are written little-endian");
+
+void WriteTrace(std::ostream &out, const std::vector<TraceEntry> &entries) {
+  const auto flags = out.flags();
+  out << std::hex << std::uppercase << std::setfill('0');
+  for (const auto &entry : entries) {
+    // NOLINTNEXTLINE(*-magic-numbers)
+    const auto x = (entry.instruction & 0x0F00) >> 8;
+    out << "PC=" << std::setw(3) << entry.programCounter
+        << " OP=" << std::setw(4) << entry.instruction
+        << " I=" << std::setw(3) << entry.index << " V" << x << '='
+        << std::setw(2) << static_cast<int>(entry.vx)
+        << " VF=" << std::setw(2) << static_cast<int>(entry.vf) << '\n';
+  }
+  out.flags(flags);
+}
+
+TraceWriter::TraceWriter(const std::filesystem::path &path)
+    : _file(path, std::ios::binary | std::ios::trunc) {
+  if (!_file) {
+    throw std::runtime_error("Cannot open trace file: " + path.string());
+  }
+  constexpr static std::array<char, 4> MAGIC{'C', '8', 'T', 'R'};
+  constexpr static std::uint32_t VERSION = 1;
+  constexpr static std::uint32_t ENTRY_BYTES = sizeof(TraceEntry);
+  constexpr static std::uint32_t RESERVED = 0;
+  _file.write(MAGIC.data(), MAGIC.size());
+  // NOLINTBEGIN(*-reinterpret-cast)
+  _file.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+  _file.write(reinterpret_cast<const char *>(&ENTRY_BYTES), sizeof(ENTRY_BYTES));
+  _file.write(reinterpret_cast<const char *>(&RESERVED), sizeof(RESERVED));
+  // NOLINTEND(*-reinterpret-cast)
+  _buffer.reserve(BUFFER_ENTRIES);
+}
+
+void TraceWriter::Flush() {
+  // NOLINTNEXTLINE(*-reinterpret-cast)
+  _file.write(reinterpret_cast<const char *>(_buffer.data()),
+              static_cast<std::streamsize>(_buffer.size() * sizeof(TraceEntry)));
+  _file.flush();
+  _buffer.clear();
+}
+
+TraceWriter::~TraceWriter() { Flush(); }
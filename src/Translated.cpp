@@ -0,0 +1,48 @@
+#include "Translated.hpp"
+#include "StateHash.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+std::uint64_t TranslatedProgram::HashRom(std::span<const std::uint8_t> rom) {
+  StateHasher hasher;
+  for (const auto byte : rom) {
+    hasher.Add(byte);
+  }
+  return hasher.Value();
+}
+
+TranslatedRunner::TranslatedRunner(Chip8 *chip,
+                                   const TranslatedProgram &program)
+    : _chip(chip), _program(program), _native(*chip, program.codeMap) {
+  constexpr static std::size_t PROGRAM_START = 0x200;
+  // a ROM too large to fit reads back short and cannot match
+  std::vector<std::uint8_t> loaded(
+    std::min(_program.rom.size(), Chip8::MEMORY_BYTES - PROGRAM_START));
+  _chip->ReadMemory(PROGRAM_START, loaded);
+  if (!std::ranges::equal(_program.rom, loaded)) {
+    throw std::invalid_argument("Loaded program does not match translation");
+  }
+  _native.CodeModified();
+}
+
+void TranslatedRunner::Step(std::size_t count) {
+  while (count > 0) {
+    const auto address = _native.ProgramCounter();
+    const auto block = _valid && address < _program.blocks.size()
+                         ? _program.blocks[address]
+                         : nullptr;
+    if (block != nullptr) {
+      count -= block(_native, count);
+    } else {
+      _chip->Step(1);
+      --count;
+    }
+    _valid = _valid && !_native.CodeModified();
+  }
+}
+
+void TranslatedRunner::RunFrame() {
+  Step(Chip8::INSTRUCTIONS_PER_FRAME);
+  _chip->TickFrameTimers();
+}
@@ -7,16 +7,21 @@
 #include <SDL2/SDL_rect.h>
 #include <SDL2/SDL_render.h>
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <iomanip>
+#include <iostream>
 #include <memory>
 
-SdlManager::SdlManager(int widthPixels, int heightPixels, Keyboard *keyboard)
-    : _screenWidth(static_cast<std::size_t>(widthPixels * PIXEL_RATIO)),
+SdlManager::SdlManager(int widthPixels, int heightPixels, Keyboard *keyboard,
+                       const std::atomic<bool> *tone)
+    : _tone(tone),
+      _screenWidth(static_cast<std::size_t>(widthPixels * PIXEL_RATIO)),
       _screenHeight(static_cast<std::size_t>(heightPixels * PIXEL_RATIO)),
       _width(widthPixels), _height(heightPixels), _keyboard(keyboard) {
-  _pixels.reserve(widthPixels * heightPixels);
+  _pixels.resize(static_cast<std::size_t>(widthPixels * heightPixels));
   (void)_keyboard;
-  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+  if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     throw SdlError();
   }
   _window =
@@ -28,71 +33,255 @@ SdlManager::SdlManager(int widthPixels, int heightPixels, Keyboard *keyboard)
   }
   _surface = SDL_GetWindowSurface(_window);
   // NOLINTNEXTLINE
-  _renderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED);
+  _renderer = SDL_CreateRenderer(_window, -1,
+                                 SDL_RENDERER_ACCELERATED |
+                                   SDL_RENDERER_PRESENTVSYNC);
+  if (_renderer == nullptr) {
+    throw SdlError();
+  }
+  constexpr static int FALLBACK_REFRESH_HZ = 60;
+  SDL_DisplayMode mode{};
+  const bool knownRate =
+    SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(_window), &mode) == 0 &&
+    mode.refresh_rate > 0;
+  _refreshPeriod = Clock::duration{std::chrono::seconds{1}} /
+                   (knownRate ? mode.refresh_rate : FALLBACK_REFRESH_HZ);
+  _refreshSeconds.Set(std::chrono::duration<double>(_refreshPeriod).count());
+  _frameReadyEvent = SDL_RegisterEvents(1);
+  if (_frameReadyEvent == static_cast<Uint32>(-1)) {
+    throw SdlError();
+  }
   _texture =
       SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_RGB888,
                         SDL_TEXTUREACCESS_STREAMING, widthPixels, heightPixels);
-  _audio = std::make_unique<AudioManager>();
+  _audio = std::make_unique<AudioManager>(tone);
 }
 
 void SdlManager::TryRenderFrame() {
-  const auto frame = _frameBuffer.TryDequeue();
-  if (!frame.has_value() || frame->size() != _width * _height) {
+  // only the newest frame is worth presenting
+  while (auto frame = _frameBuffer.TryDequeue()) {
+    _dequeued.Add();
+    if (frame->frame.width > _width || frame->frame.height > _height) {
+      continue;
+    }
+    if (_pendingFrame) {
+      _dropped.Add();
+      frame->queued = _pendingFrame->queued;
+    }
+    _pendingFrame = std::move(frame);
+  }
+  if (!_pendingFrame || Clock::now() < _nextPresent) {
+    return;
+  }
+  const auto started = Clock::now();
+  RenderFrame(_pendingFrame->frame);
+  RecordPresent(started, Clock::now());
+  if (_onFirstPresent) {
+    _onFirstPresent();
+    _onFirstPresent = nullptr;
+  }
+}
+
+void SdlManager::StartAudioIfNeeded() {
+  if (_audio->IsOpen() || _audioFailed ||
+      !_tone->load(std::memory_order_relaxed)) {
     return;
   }
-  RenderFrame(*frame);
+  try {
+    _audio->Open();
+  } catch (const SdlError &e) {
+    std::cerr << "Audio disabled: " << e.what() << '\n';
+    _audioFailed = true;
+  }
+}
+
+void SdlManager::RecordPresent(Clock::time_point started,
+                               Clock::time_point finished) {
+  // with vsync, RenderPresent returns at the refresh, so back-to-back
+  // presents measure the refresh period
+  const auto interval = finished - _lastPresent;
+  if (interval > _refreshPeriod / 2 && interval < _refreshPeriod * 3 / 2) {
+    _refreshPeriod += (interval - _refreshPeriod) / 8;
+    _refreshSeconds.Set(std::chrono::duration<double>(_refreshPeriod).count());
+  }
+  _renderCost += (finished - started - _renderCost) / 8;
+  const auto latency = finished - _pendingFrame->queued;
+  _latency.Record(latency);
+  if (latency > _refreshPeriod * 3 / 2) {
+    _missed.Add();
+  }
+  _pendingFrame.reset();
+  _lastPresent = finished;
+  // start the next render just early enough to make the following refresh
+  _nextPresent = finished + _refreshPeriod - _renderCost;
+}
+
+int SdlManager::WaitTimeout() const {
+  constexpr static int IDLE_TIMEOUT_MS = 100;
+  // until audio starts, check the tone once per frame so the first beep is
+  // not late by a whole idle timeout
+  constexpr static int AUDIO_POLL_MS = 16;
+  if (!_pendingFrame) {
+    // a queued frame wakes the loop with an event
+    return _audio->IsOpen() || _audioFailed ? IDLE_TIMEOUT_MS : AUDIO_POLL_MS;
+  }
+  const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+    _nextPresent - Clock::now());
+  return static_cast<int>(std::max<std::chrono::milliseconds::rep>(
+    remaining.count(), 0));
+}
+
+void SdlManager::WriteSummary(std::ostream &out) const {
+  const auto microseconds = [](std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+  };
+  out << std::fixed << std::setprecision(1)
+      << "render: frames=" << _latency.Count()
+      << " dropped=" << _dropped.Value() << " missed=" << _missed.Value()
+      << " refresh_us="
+      << microseconds(_refreshPeriod)
+      << " latency_us mean=" << microseconds(_latency.Mean())
+      << " p99=" << microseconds(_latency.Quantile(0.99))
+      << " max=" << microseconds(_latency.Max()) << '\n';
+}
+
+void SdlManager::RegisterMetrics(MetricsRegistry &registry) const {
+  registry.Add("chip8_present_latency_seconds",
+               "Time from queueing a frame to presenting it", _latency);
+  registry.Add("chip8_frames_dropped_total",
+               "Frames replaced by a newer one before being presented",
+               _dropped);
+  registry.Add("chip8_present_deadlines_missed_total",
+               "Frames presented more than 1.5 refresh periods after queueing",
+               _missed);
+  registry.Add("chip8_frame_queue_depth",
+               "Frames queued by the emulation thread and not yet taken by "
+               "the render thread",
+               [this]() {
+                 const auto dequeued = _dequeued.Value();
+                 const auto queued = _queued.value.Value();
+                 return static_cast<double>(queued - std::min(queued, dequeued));
+               });
+  registry.Add("chip8_display_refresh_seconds",
+               "Estimated display refresh period", _refreshSeconds);
+  _audio->RegisterMetrics(registry);
+}
+
+SdlManager::Frame SdlManager::Frame::Capture(const Screen &screen) {
+  Frame frame{screen.Width(), screen.Height(), {}};
+  for (std::size_t plane = 0; plane < Screen::NUM_PLANES; ++plane) {
+    std::ranges::copy(screen.Rows(plane), frame.planes.at(plane).begin());
+  }
+  return frame;
+}
+
+void SdlManager::ConvertFrame(const Frame &frame, std::span<Uint32> pixels) {
+  constexpr static std::size_t WORD_BITS = 64;
+  const auto words = (frame.width + WORD_BITS - 1) / WORD_BITS;
+  auto out = pixels.begin();
+  for (std::size_t y = 0; y < frame.height; ++y) {
+    for (std::size_t word = 0; word < words; ++word) {
+      std::array<std::uint64_t, Screen::NUM_PLANES> bits{};
+      for (std::size_t plane = 0; plane < bits.size(); ++plane) {
+        bits.at(plane) = frame.planes.at(plane).at(y).at(word);
+      }
+      const auto width = std::min(WORD_BITS, frame.width - word * WORD_BITS);
+      for (std::size_t x = 0; x < width; ++x, ++out) {
+        std::size_t color = 0;
+        for (std::size_t plane = 0; plane < bits.size(); ++plane) {
+          // NOLINTNEXTLINE(*-array-index)
+          color |= (bits[plane] >> x & 1U) << plane;
+        }
+        // NOLINTNEXTLINE(*-array-index)
+        *out = PALETTE[color];
+      }
+    }
+  }
 }
 
 void SdlManager::RenderFrame(const Frame &toRender) {
-  constexpr static Uint32 PIXEL_ON = 0xFFF;
-  constexpr static Uint32 PIXEL_OFF = 0x000;
-  std::transform(toRender.begin(), toRender.end(), _pixels.begin(),
-                 [](bool on) { return on ? PIXEL_ON : PIXEL_OFF; });
-  SDL_UpdateTexture(_texture, nullptr, _pixels.data(),
-                    static_cast<int>(_width * sizeof(Uint32)));
+  ConvertFrame(toRender, _pixels);
+  // lower resolutions use the top-left corner of the texture
+  const SDL_Rect area = {0, 0, static_cast<int>(toRender.width),
+                         static_cast<int>(toRender.height)};
+  SDL_UpdateTexture(_texture, &area, _pixels.data(),
+                    static_cast<int>(toRender.width * sizeof(Uint32)));
   SDL_Rect destRect = {0, 0, static_cast<int>(_screenWidth),
                        static_cast<int>(_screenHeight)};
-  SDL_RenderCopy(_renderer, _texture, nullptr, &destRect);
+  SDL_RenderCopy(_renderer, _texture, &area, &destRect);
   SDL_RenderPresent(_renderer);
 }
 
+void SdlManager::RegisterFirstPresentCallback(std::function<void()> callback) {
+  _onFirstPresent = std::move(callback);
+}
+
 void SdlManager::QueueFrame(Frame frame) {
-  _frameBuffer.Enqueue(std::move(frame));
+  // counted first so that the depth never appears negative
+  _queued.value.Add();
+  _frameBuffer.Enqueue({std::move(frame), Clock::now()});
+  // one wake-up event in flight is enough; the loop drains the whole queue
+  if (!_wakePending.value.exchange(true)) {
+    SDL_Event event{};
+    event.type = _frameReadyEvent;
+    SDL_PushEvent(&event);
+  }
 }
 
-void SdlManager::SetKeyStatus(SDL_Keycode key, bool status) {
+std::optional<std::size_t> SdlManager::KeyIndex(SDL_Keycode key) {
   static constexpr auto keys = std::array{
       SDLK_x, SDLK_1, SDLK_2, SDLK_3, SDLK_q, SDLK_w, SDLK_e, SDLK_a,
       SDLK_s, SDLK_d, SDLK_z, SDLK_c, SDLK_4, SDLK_r, SDLK_f, SDLK_v,
   };
   const auto *const keyIter = std::find(keys.begin(), keys.end(), key);
-  if (keyIter != keys.end()) {
-    _keyboard->SetKeyPressed(keyIter - keys.begin(), status);
+  if (keyIter == keys.end()) {
+    return std::nullopt;
+  }
+  return static_cast<std::size_t>(keyIter - keys.begin());
+}
+
+void SdlManager::SetKeyStatus(SDL_Keycode key, bool status) {
+  if (const auto index = KeyIndex(key)) {
+    _keyboard->SetKeyPressed(*index, status);
+  }
+}
+
+bool SdlManager::HandleEvent(const SDL_Event &event) {
+  if (event.type == _frameReadyEvent) {
+    _wakePending.value = false;
+    return false;
+  }
+  switch (event.type) {
+  case SDL_QUIT:
+    return true;
+  case SDL_KEYDOWN:
+    SetKeyStatus(event.key.keysym.sym, true);
+    break;
+  case SDL_KEYUP:
+    SetKeyStatus(event.key.keysym.sym, false);
+    break;
   }
+  return false;
 }
 
 void SdlManager::Run() {
   SDL_Event e;
   bool quit = false;
   while (!quit) {
-    while (SDL_PollEvent(&e) != 0) {
-      switch (e.type) {
-      case SDL_QUIT:
-        quit = true;
-        break;
-      case SDL_KEYDOWN:
-        SetKeyStatus(e.key.keysym.sym, true);
-        break;
-      case SDL_KEYUP:
-        SetKeyStatus(e.key.keysym.sym, false);
-        break;
+    if (SDL_WaitEventTimeout(&e, WaitTimeout()) != 0) {
+      quit = HandleEvent(e);
+      while (!quit && SDL_PollEvent(&e) != 0) {
+        quit = HandleEvent(e);
       }
     }
+    StartAudioIfNeeded();
     TryRenderFrame();
   }
 }
 
 SdlManager::~SdlManager() {
+  // the device must close before SDL shuts down
+  _audio.reset();
   SDL_DestroyWindow(_window);
   SDL_Quit();
 }
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "VecEnv.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <memory>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+// the segment is shared between processes, so these are the non-private
+// futex operations (std::atomic::wait may use process-private ones)
+void FutexWait(std::atomic<std::uint32_t> &word, std::uint32_t expected) {
+  // NOLINTNEXTLINE(*-vararg, *-reinterpret-cast)
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT,
+          expected, nullptr, nullptr, 0);
+}
+
+void FutexWakeAll(std::atomic<std::uint32_t> &word) {
+  // NOLINTNEXTLINE(*-vararg, *-reinterpret-cast)
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE,
+          INT_MAX, nullptr, nullptr, 0);
+}
+
+std::size_t SegmentBytes(std::size_t numEnvs) {
+  return sizeof(VecEnvHeader) + numEnvs * sizeof(VecEnvSlot);
+}
+
+std::span<VecEnvSlot> SlotsAfter(VecEnvHeader *header, std::size_t numEnvs) {
+  // NOLINTNEXTLINE(*-reinterpret-cast, *-pointer-arithmetic)
+  auto *first = reinterpret_cast<VecEnvSlot *>(header + 1);
+  return {first, numEnvs};
+}
+
+void *MapSegment(int fd, std::size_t bytes) {
+  void *base =
+    mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(), "mmap");
+  }
+  return base;
+}
+} // namespace
+
+VecEnvProbe VecEnvProbe::Parse(std::string_view spec) {
+  const auto colon = spec.find(':');
+  const auto kind = spec.substr(0, colon);
+  if (colon == std::string_view::npos || (kind != "mem" && kind != "reg")) {
+    throw std::invalid_argument("Expected mem:<addr> or reg:<x>, got " +
+                                std::string(spec));
+  }
+  const std::string location{spec.substr(colon + 1)};
+  std::size_t parsed = 0;
+  const auto value = std::stoul(location, &parsed, 16);
+  constexpr static std::size_t NUM_V_REGISTERS = 16;
+  if (parsed != location.size() ||
+      (kind == "reg" && value >= NUM_V_REGISTERS)) {
+    throw std::invalid_argument("Invalid location in " + std::string(spec));
+  }
+  return {kind == "mem" ? Source::MEMORY : Source::REGISTER, value};
+}
+
+std::uint8_t VecEnvProbe::Read(const Chip8Core &core) const {
+  if (source == Source::MEMORY) {
+    return core.Machine().PeekMemory(location);
+  }
+  return core.GetState().registers.at(location);
+}
+
+VecEnvServer::VecEnvServer(std::string name,
+                           std::span<const std::uint8_t> program,
+                           VecEnvConfig config)
+    : _name(std::move(name)), _config(config),
+      _bytes(SegmentBytes(config.numEnvs)) {
+  if (_config.numEnvs == 0 || _config.workers == 0) {
+    throw std::invalid_argument("Need at least one environment and worker");
+  }
+  _config.workers = std::min(_config.workers, _config.numEnvs);
+
+  // a stale segment from a crashed server would keep old sizes
+  shm_unlink(_name.c_str());
+  const int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "shm_open");
+  }
+  if (ftruncate(fd, static_cast<off_t>(_bytes)) != 0) {
+    const auto error = errno;
+    close(fd);
+    shm_unlink(_name.c_str());
+    throw std::system_error(error, std::generic_category(), "ftruncate");
+  }
+  void *base = nullptr;
+  try {
+    base = MapSegment(fd, _bytes);
+  } catch (...) {
+    close(fd);
+    shm_unlink(_name.c_str());
+    throw;
+  }
+  close(fd);
+
+  _header = new (base) VecEnvHeader();
+  _slots = SlotsAfter(_header, _config.numEnvs);
+  std::uninitialized_value_construct(_slots.begin(), _slots.end());
+
+  _envs.resize(_config.numEnvs);
+  for (auto &env : _envs) {
+    env.core = Chip8Core::Create();
+    env.core->Machine().SetTraceDumpStream(nullptr);
+    env.core->LoadProgram(program);
+  }
+  // every episode starts from the same state, apart from the RNG
+  _envs.front().core->Machine().Save(_initial);
+  for (std::size_t i = 0; i < _envs.size(); ++i) {
+    ResetEnv(i);
+  }
+
+  _header->magic = VecEnvHeader::MAGIC;
+  _header->version = VecEnvHeader::VERSION;
+  _header->numEnvs = static_cast<std::uint32_t>(_config.numEnvs);
+  _header->framesPerStep = static_cast<std::uint32_t>(_config.framesPerStep);
+  _header->pending = static_cast<std::uint32_t>(_config.workers);
+}
+
+VecEnvServer::~VecEnvServer() {
+  munmap(_header, _bytes);
+  shm_unlink(_name.c_str());
+}
+
+void VecEnvServer::Serve() {
+  // exactly `workers` non-empty ranges, since workers <= numEnvs
+  std::vector<std::thread> workers;
+  const auto count = _config.workers;
+  for (std::size_t w = 0; w < count; ++w) {
+    const auto first = w * _config.numEnvs / count;
+    const auto last = (w + 1) * _config.numEnvs / count;
+    workers.emplace_back([this, first, last]() { RunWorker(first, last); });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void VecEnvServer::RunWorker(std::size_t first, std::size_t last) {
+  const auto numWorkers = static_cast<std::uint32_t>(_config.workers);
+  std::uint32_t generation = 0;
+  while (true) {
+    while (_header->stepRequest.load(std::memory_order_acquire) ==
+           generation) {
+      FutexWait(_header->stepRequest, generation);
+    }
+    if (_header->shutdown.load(std::memory_order_acquire) != 0) {
+      return;
+    }
+    generation = _header->stepRequest.load(std::memory_order_acquire);
+    for (auto i = first; i < last; ++i) {
+      StepEnv(i);
+    }
+    if (_header->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      // last worker: re-arm for the next step before publishing this one
+      _header->pending.store(numWorkers, std::memory_order_relaxed);
+      _header->stepDone.store(generation, std::memory_order_release);
+      FutexWakeAll(_header->stepDone);
+    }
+  }
+}
+
+void VecEnvServer::StepEnv(std::size_t index) {
+  auto &slot = _slots[index];
+  auto &env = _envs[index];
+  if (slot.reset != 0 || slot.done != 0) {
+    ResetEnv(index);
+  }
+  auto &core = *env.core;
+  constexpr static std::size_t NUM_KEYS = 16;
+  for (std::size_t key = 0; key < NUM_KEYS; ++key) {
+    core.SetKey(key, ((slot.action >> key) & 1U) != 0);
+  }
+  try {
+    for (std::size_t frame = 0; frame < _config.framesPerStep; ++frame) {
+      core.RunFrame();
+    }
+  } catch (const std::exception &) {
+    slot.error = 1;
+  }
+  slot.episodeFrames += static_cast<std::uint32_t>(_config.framesPerStep);
+
+  slot.reward = 0;
+  if (_config.reward) {
+    const auto value = _config.reward->Read(core);
+    slot.reward = static_cast<float>(static_cast<int>(value) -
+                                     static_cast<int>(env.lastReward));
+    env.lastReward = value;
+  }
+  const bool doneByProbe =
+    _config.done && _config.done->Read(core) == _config.doneValue;
+  const bool doneByLimit = _config.maxEpisodeFrames != 0 &&
+                           slot.episodeFrames >= _config.maxEpisodeFrames;
+  slot.done = slot.error != 0 || doneByProbe || doneByLimit ? 1 : 0;
+
+  const auto &screen = core.Framebuffer();
+  slot.highResolution = screen.HighResolution() ? 1 : 0;
+  // a pixel is lit if it is set in any XO-CHIP plane
+  const auto copied =
+    std::ranges::copy(screen.Rows(), slot.observation.begin());
+  std::fill(copied.out, slot.observation.end(), Screen::Row{});
+  for (std::size_t plane = 1; plane < Screen::NUM_PLANES; ++plane) {
+    const auto rows = screen.Rows(plane);
+    for (std::size_t y = 0; y < rows.size(); ++y) {
+      slot.observation.at(y)[0] |= rows[y][0];
+      slot.observation.at(y)[1] |= rows[y][1];
+    }
+  }
+}
+
+void VecEnvServer::ResetEnv(std::size_t index) {
+  auto &slot = _slots[index];
+  auto &env = _envs[index];
+  env.core->Machine().Restore(_initial);
+  // keyed by the environment, not the worker stepping it, so results do not
+  // depend on the worker count
+  auto &random = env.core->Machine().Random();
+  random = RandomNumberGenerator{_config.seed, index};
+  random.Seek(env.episodes++ << EPISODE_DRAWS_SHIFT);
+  env.lastReward = _config.reward ? _config.reward->Read(*env.core) : 0;
+  slot.reset = 0;
+  slot.done = 0;
+  slot.error = 0;
+  slot.episodeFrames = 0;
+}
+
+VecEnvClient::VecEnvClient(const std::string &name) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "shm_open");
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) < sizeof(VecEnvHeader)) {
+    close(fd);
+    throw std::runtime_error("Not a vectorized environment: " + name);
+  }
+  _bytes = static_cast<std::size_t>(info.st_size);
+  void *base = nullptr;
+  try {
+    base = MapSegment(fd, _bytes);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+  _header = static_cast<VecEnvHeader *>(base);
+  if (_header->magic != VecEnvHeader::MAGIC ||
+      _header->version != VecEnvHeader::VERSION ||
+      SegmentBytes(_header->numEnvs) != _bytes) {
+    munmap(base, _bytes);
+    throw std::runtime_error("Incompatible vectorized environment: " + name);
+  }
+  _slots = SlotsAfter(_header, _header->numEnvs);
+}
+
+VecEnvClient::~VecEnvClient() { munmap(_header, _bytes); }
+
+void VecEnvClient::Step() {
+  const auto generation =
+    _header->stepRequest.fetch_add(1, std::memory_order_acq_rel) + 1;
+  FutexWakeAll(_header->stepRequest);
+  for (auto done = _header->stepDone.load(std::memory_order_acquire);
+       done != generation;
+       done = _header->stepDone.load(std::memory_order_acquire)) {
+    FutexWait(_header->stepDone, done);
+  }
+}
+
+void VecEnvClient::Shutdown() {
+  _header->shutdown.store(1, std::memory_order_release);
+  _header->stepRequest.fetch_add(1, std::memory_order_acq_rel);
+  FutexWakeAll(_header->stepRequest);
+}
@@ -0,0 +1,294 @@
+#include "Wall.hpp"
+#include "Constants.hpp"
+#include "SdlError.hpp"
+#include "UI.hpp"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_events.h>
+#include <SDL2/SDL_keycode.h>
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+constexpr std::size_t WORD_BITS = 64;
+constexpr std::size_t NUM_KEYS = 16;
+constexpr Uint32 FOCUS_COLOR = 0xFF0000;
+
+/**
+ * @brief the bits of a byte spread out to one per nibble, so that OR-ing the
+ * shifted spreads of every plane yields eight palette indices at once
+ */
+constexpr auto SPREAD = []() {
+  std::array<std::uint32_t, Constants::MAX_BYTE + 1> spread{};
+  for (std::size_t value = 0; value < spread.size(); ++value) {
+    for (unsigned int bit = 0; bit < Constants::BITS_PER_BYTE; ++bit) {
+      if ((value >> bit & 1U) != 0) {
+        spread.at(value) |= 1U << (bit * Screen::NUM_PLANES);
+      }
+    }
+  }
+  return spread;
+}();
+
+/**
+ * @brief outline a tile, so the focused machine stands out
+ */
+void DrawBorder(std::span<Uint32> pixels) {
+  constexpr auto WIDTH = WallManager::TILE_WIDTH;
+  constexpr auto HEIGHT = WallManager::TILE_HEIGHT;
+  std::fill_n(pixels.begin(), WIDTH, FOCUS_COLOR);
+  std::fill_n(pixels.end() - WIDTH, WIDTH, FOCUS_COLOR);
+  for (std::size_t y = 1; y + 1 < HEIGHT; ++y) {
+    // NOLINTBEGIN(*-array-index)
+    pixels[y * WIDTH] = FOCUS_COLOR;
+    pixels[y * WIDTH + WIDTH - 1] = FOCUS_COLOR;
+    // NOLINTEND(*-array-index)
+  }
+}
+} // namespace
+
+WallManager::WallManager(std::vector<std::unique_ptr<Chip8Core>> instances)
+    : _pixels(TILE_WIDTH * TILE_HEIGHT), _pacer(Chip8::FRAME_PERIOD) {
+  if (instances.empty()) {
+    throw std::invalid_argument("A wall needs at least one instance");
+  }
+  for (auto &core : instances) {
+    _tiles.push_back({std::move(core), STALE});
+  }
+  // as square as possible, filled row by row
+  _columns = static_cast<std::size_t>(
+    std::ceil(std::sqrt(static_cast<double>(_tiles.size()))));
+  _rows = (_tiles.size() + _columns - 1) / _columns;
+  const auto atlasWidth = static_cast<int>(_columns * TILE_WIDTH);
+  const auto atlasHeight = static_cast<int>(_rows * TILE_HEIGHT);
+
+  // scale the atlas to a comfortable window; SDL_RenderCopy stretches it
+  constexpr static double MAX_SCALE = 5;
+  constexpr static double MAX_WIDTH = 1600;
+  constexpr static double MAX_HEIGHT = 900;
+  const auto scale = std::min({MAX_SCALE, MAX_WIDTH / atlasWidth,
+                               MAX_HEIGHT / atlasHeight});
+  if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+    throw SdlError();
+  }
+  const auto title =
+    "Chip8 wall: " + std::to_string(_tiles.size()) + " instances";
+  _window = SDL_CreateWindow(
+    title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+    static_cast<int>(atlasWidth * scale), static_cast<int>(atlasHeight * scale),
+    SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+  if (_window == nullptr) {
+    throw SdlError();
+  }
+  // the pacer keeps the machines at 60Hz, so presenting must not block
+  _renderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED);
+  if (_renderer == nullptr) {
+    throw SdlError();
+  }
+  _atlas = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_RGB888,
+                             SDL_TEXTUREACCESS_STREAMING, atlasWidth,
+                             atlasHeight);
+  if (_atlas == nullptr) {
+    throw SdlError();
+  }
+  // the cells past the last tile are never uploaded; blank them once, or they
+  // show whatever the new streaming texture happens to hold
+  std::ranges::fill(_pixels, SdlManager::PALETTE[0]);
+  for (auto cell = _tiles.size(); cell < _columns * _rows; ++cell) {
+    const auto area = TileArea(cell);
+    SDL_UpdateTexture(_atlas, &area, _pixels.data(),
+                      static_cast<int>(TILE_WIDTH * sizeof(Uint32)));
+  }
+}
+
+void WallManager::ConvertTile(const Screen &screen, std::span<Uint32> pixels) {
+  // both resolutions have the same aspect ratio
+  const auto scale = TILE_WIDTH / screen.Width();
+  const auto words = screen.Width() / WORD_BITS;
+  std::array<std::span<const Screen::Row>, Screen::NUM_PLANES> planes;
+  for (std::size_t plane = 0; plane < planes.size(); ++plane) {
+    planes.at(plane) = screen.Rows(plane);
+  }
+  for (std::size_t y = 0; y < screen.Height(); ++y) {
+    const auto row = pixels.subspan(y * scale * TILE_WIDTH, TILE_WIDTH);
+    auto out = row.begin();
+    for (std::size_t word = 0; word < words; ++word) {
+      // NOLINTBEGIN(*-array-index)
+      std::array<std::uint64_t, Screen::NUM_PLANES> bits{};
+      std::uint64_t any = 0;
+      for (std::size_t plane = 0; plane < bits.size(); ++plane) {
+        bits[plane] = planes[plane][y][word];
+        any |= bits[plane];
+      }
+      if (any == 0) {
+        // most of a typical screen is background
+        out = std::fill_n(out, WORD_BITS * scale, SdlManager::PALETTE[0]);
+        continue;
+      }
+      for (std::size_t x = 0; x < WORD_BITS; x += Constants::BITS_PER_BYTE) {
+        std::uint32_t colors = 0;
+        for (std::size_t plane = 0; plane < bits.size(); ++plane) {
+          colors |= SPREAD[bits[plane] >> x & Constants::MAX_BYTE] << plane;
+        }
+        for (unsigned int pixel = 0; pixel < Constants::BITS_PER_BYTE;
+             ++pixel) {
+          out = std::fill_n(
+            out, scale,
+            SdlManager::PALETTE[colors >> (pixel * Screen::NUM_PLANES) &
+                                (Screen::NUM_COLORS - 1)]);
+        }
+      }
+      // NOLINTEND(*-array-index)
+    }
+    for (std::size_t copy = 1; copy < scale; ++copy) {
+      std::ranges::copy(row, pixels.begin() + static_cast<std::ptrdiff_t>(
+                                                (y * scale + copy) *
+                                                TILE_WIDTH));
+    }
+  }
+}
+
+void WallManager::RunInstances() {
+  for (std::size_t i = 0; i < _tiles.size(); ++i) {
+    auto &tile = _tiles[i];
+    if (tile.stopped) {
+      continue;
+    }
+    try {
+      tile.core->RunFrame();
+    } catch (const std::exception &e) {
+      // the tile keeps showing the last frame
+      std::cerr << "Instance " << i << " stopped: " << e.what() << '\n';
+      tile.stopped = true;
+    }
+  }
+}
+
+SDL_Rect WallManager::TileArea(std::size_t tile) const {
+  return {static_cast<int>(tile % _columns * TILE_WIDTH),
+          static_cast<int>(tile / _columns * TILE_HEIGHT),
+          static_cast<int>(TILE_WIDTH), static_cast<int>(TILE_HEIGHT)};
+}
+
+void WallManager::Present() {
+  for (std::size_t i = 0; i < _tiles.size(); ++i) {
+    auto &tile = _tiles[i];
+    const auto &screen = tile.core->Framebuffer();
+    const auto updates = screen.UpdateCount();
+    if (updates == tile.uploaded) {
+      continue;
+    }
+    ConvertTile(screen, _pixels);
+    if (i == _focus) {
+      DrawBorder(_pixels);
+    }
+    const auto area = TileArea(i);
+    SDL_UpdateTexture(_atlas, &area, _pixels.data(),
+                      static_cast<int>(TILE_WIDTH * sizeof(Uint32)));
+    tile.uploaded = updates;
+    _uploads.Add();
+  }
+  SDL_RenderCopy(_renderer, _atlas, nullptr, nullptr);
+  SDL_RenderPresent(_renderer);
+  _presents.Add();
+}
+
+void WallManager::Focus(std::size_t tile) {
+  if (tile == _focus) {
+    return;
+  }
+  for (std::size_t key = 0; key < NUM_KEYS; ++key) {
+    _tiles[_focus].core->SetKey(key, false);
+  }
+  // redraw both outlines
+  _tiles[_focus].uploaded = STALE;
+  _tiles[tile].uploaded = STALE;
+  _focus = tile;
+}
+
+bool WallManager::HandleEvent(const SDL_Event &event) {
+  const auto count = _tiles.size();
+  switch (event.type) {
+  case SDL_QUIT:
+    return true;
+  case SDL_KEYDOWN:
+    switch (event.key.keysym.sym) {
+    case SDLK_TAB:
+      Focus((event.key.keysym.mod & KMOD_SHIFT) != 0
+              ? (_focus + count - 1) % count
+              : (_focus + 1) % count);
+      return false;
+    case SDLK_LEFT:
+      Focus((_focus + count - 1) % count);
+      return false;
+    case SDLK_RIGHT:
+      Focus((_focus + 1) % count);
+      return false;
+    case SDLK_UP:
+      Focus(_focus >= _columns ? _focus - _columns : _focus);
+      return false;
+    case SDLK_DOWN:
+      Focus(_focus + _columns < count ? _focus + _columns : _focus);
+      return false;
+    default:
+      break;
+    }
+    [[fallthrough]];
+  case SDL_KEYUP:
+    if (const auto key = SdlManager::KeyIndex(event.key.keysym.sym)) {
+      _tiles[_focus].core->SetKey(*key, event.type == SDL_KEYDOWN);
+    }
+    return false;
+  case SDL_MOUSEBUTTONDOWN: {
+    int width = 0;
+    int height = 0;
+    SDL_GetWindowSize(_window, &width, &height);
+    if (width <= 0 || height <= 0) {
+      return false;
+    }
+    const auto column = static_cast<std::size_t>(event.button.x) * _columns /
+                        static_cast<std::size_t>(width);
+    const auto row = static_cast<std::size_t>(event.button.y) * _rows /
+                     static_cast<std::size_t>(height);
+    if (column < _columns && row * _columns + column < count) {
+      Focus(row * _columns + column);
+    }
+    return false;
+  }
+  default:
+    return false;
+  }
+}
+
+void WallManager::Run() {
+  SDL_Event event;
+  bool quit = false;
+  while (!quit) {
+    while (!quit && SDL_PollEvent(&event) != 0) {
+      quit = HandleEvent(event);
+    }
+    RunInstances();
+    Present();
+    _pacer.Wait();
+  }
+  _pacer.WriteSummary(std::cerr, "wall");
+}
+
+void WallManager::WriteSummary(std::ostream &out) const {
+  out << "wall: tiles=" << _tiles.size() << " presents=" << _presents.Value()
+      << " uploads=" << _uploads.Value() << '\n';
+}
+
+WallManager::~WallManager() {
+  SDL_DestroyTexture(_atlas);
+  SDL_DestroyRenderer(_renderer);
+  SDL_DestroyWindow(_window);
+  SDL_Quit();
+}
@@ -0,0 +1,52 @@
+#include "Chip8Core.hpp"
+#include "Wall.hpp"
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// chip8_wall: runs many headless machines and shows them tiled in one window.
+//
+//   chip8_wall [--instances N] ROM...
+//
+// Machines load the ROMs in turn, so `--instances 256 a.ch8 b.ch8` runs 128
+// copies of each. Machines running the same ROM share its memory pages.
+
+int main(int argc, char **argv) {
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  std::size_t count = 0;
+  std::vector<std::filesystem::path> roms;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (args[i] == "--instances" && i + 1 < args.size()) {
+      count = std::stoul(args[++i]);
+    } else {
+      roms.emplace_back(args[i]);
+    }
+  }
+  if (roms.empty()) {
+    std::cerr << "usage: chip8_wall [--instances N] ROM...\n";
+    return 1;
+  }
+  if (count == 0) {
+    count = roms.size();
+  }
+  try {
+    std::vector<std::unique_ptr<Chip8Core>> instances;
+    instances.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      auto core = Chip8Core::Create();
+      core->LoadProgram(roms[i % roms.size()]);
+      instances.push_back(std::move(core));
+    }
+    WallManager wall{std::move(instances)};
+    wall.Run();
+    wall.WriteSummary(std::cerr);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
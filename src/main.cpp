@@ -1,7 +1,19 @@
 #include "Emulator.hpp"
+#include <exception>
+#include <filesystem>
+#include <iostream>
 
-int main() {
-  Emulator emulator{"../ExamplePrograms/5-quirks.ch8"};
-  emulator.Run();
+// chip8 [ROM]; set CHIP8_HEADLESS_FRAMES=N to run N frames without a window
+int main(int argc, char **argv) {
+  const std::filesystem::path program =
+    // NOLINTNEXTLINE(*-pointer-arithmetic)
+    argc > 1 ? argv[1] : "../ExamplePrograms/5-quirks.ch8";
+  try {
+    Emulator emulator{program, Emulator::Options::FromEnvironment("CHIP8")};
+    emulator.Run();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
   return 0;
-}
\ No newline at end of file
+}
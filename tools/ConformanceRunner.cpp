@@ -0,0 +1,351 @@
+#include "Chip8Core.hpp"
+#include "Constants.hpp"
+#include "Random.hpp"
+#include "StateHash.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef CHIP8_EXAMPLE_PROGRAMS_DIR
+#define CHIP8_EXAMPLE_PROGRAMS_DIR "ExamplePrograms"
+#endif
+
+namespace {
+
+struct KeyEvent {
+  std::size_t frame;
+  std::size_t key;
+  bool pressed;
+};
+
+/**
+ * @brief one line of the golden file:
+ * `rom frames hash instructionsPerSecond [frame:key+|frame:key- ...]`
+ */
+struct GoldenEntry {
+  std::string rom;
+  std::size_t frames;
+  std::uint64_t hash;
+  double instructionsPerSecond;
+  std::vector<KeyEvent> keys;
+};
+
+struct RunResult {
+  std::uint64_t hash = 0;
+  /** over the frames actually executed */
+  double instructionsPerSecond = 0;
+  /** over all requested frames, counting skipped ones as if run */
+  double effectiveInstructionsPerSecond = 0;
+  /** frames executed; fewer than requested when loops were skipped */
+  std::size_t executed = 0;
+  /** period of the last loop skipped, 0 if none */
+  std::size_t loopPeriod = 0;
+  std::string error;
+};
+
+std::vector<GoldenEntry> ReadGolden(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot open golden file: " + path.string());
+  }
+  std::vector<GoldenEntry> entries;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    GoldenEntry entry{};
+    fields >> entry.rom >> entry.frames >> std::hex >> entry.hash >> std::dec >>
+      entry.instructionsPerSecond;
+    std::string key;
+    while (fields >> key) {
+      const auto colon = key.find(':');
+      if (colon == std::string::npos || key.size() < colon + 3) {
+        throw std::runtime_error("Invalid key event: " + key);
+      }
+      entry.keys.push_back({std::stoul(key.substr(0, colon)),
+                            std::stoul(key.substr(colon + 1), nullptr, 16),
+                            key.back() == '+'});
+    }
+    if (!fields.eof() || entry.rom.empty()) {
+      throw std::runtime_error("Invalid golden line: " + line);
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+void WriteGolden(const std::filesystem::path &path,
+                 const std::vector<GoldenEntry> &entries) {
+  std::ofstream file(path);
+  file << "# rom frames framebuffer-hash instructions-per-second [frame:key+ "
+          "frame:key-]...\n";
+  for (const auto &entry : entries) {
+    file << entry.rom << ' ' << entry.frames << ' ' << std::hex
+         << std::setw(16) << std::setfill('0') << entry.hash << std::dec << ' '
+         << static_cast<std::uint64_t>(entry.instructionsPerSecond);
+    for (const auto &key : entry.keys) {
+      file << ' ' << key.frame << ':' << std::hex << key.key << std::dec
+           << (key.pressed ? '+' : '-');
+    }
+    file << '\n';
+  }
+}
+
+// FNV-1a with one step per pixel colour, row major, independent of how the
+// screen stores its planes
+std::uint64_t HashFramebuffer(const Screen &screen) {
+  StateHasher hasher;
+  for (std::size_t y = 0; y < screen.Height(); ++y) {
+    for (std::size_t x = 0; x < screen.Width(); ++x) {
+      hasher.Add(screen.ColorAt(x, y));
+    }
+  }
+  return hasher.Value();
+}
+
+RunResult RunRom(const std::filesystem::path &romDir, const GoldenEntry &entry,
+                 bool skipLoops) {
+  RunResult result;
+  try {
+    std::ifstream file(romDir / entry.rom, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Cannot open ROM");
+    }
+    const std::vector<std::uint8_t> image{std::istreambuf_iterator<char>(file),
+                                          std::istreambuf_iterator<char>()};
+    const auto core = Chip8Core::Create();
+    core->Machine().SetTraceDumpStream(nullptr);
+    core->LoadProgram(image);
+    auto nextKey = entry.keys.begin();
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t frame = 0; frame < entry.frames;) {
+      for (; nextKey != entry.keys.end() && nextKey->frame == frame;
+           ++nextKey) {
+        core->SetKey(nextKey->key, nextKey->pressed);
+      }
+      if (!skipLoops) {
+        core->RunFrame();
+        ++result.executed;
+        ++frame;
+        continue;
+      }
+      // the keys stay as they are until the next event; out of order events
+      // are never applied, as when running frame by frame
+      const auto until = nextKey != entry.keys.end() && nextKey->frame > frame
+                           ? std::min(nextKey->frame, entry.frames)
+                           : entry.frames;
+      const auto run = core->RunFrames(until - frame);
+      result.executed += run.executed;
+      if (run.loopPeriod != 0) {
+        result.loopPeriod = run.loopPeriod;
+      }
+      frame = until;
+    }
+    const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    result.hash = HashFramebuffer(core->Framebuffer());
+    const auto seconds = std::max(elapsed.count(), 1e-9);
+    // throughput, comparable with and without loop skipping
+    result.instructionsPerSecond =
+      static_cast<double>(result.executed * Chip8::INSTRUCTIONS_PER_FRAME) /
+      seconds;
+    // the instructions the run stands for, executed or skipped
+    result.effectiveInstructionsPerSecond =
+      static_cast<double>(entry.frames * Chip8::INSTRUCTIONS_PER_FRAME) /
+      seconds;
+  } catch (const std::exception &e) {
+    result.error = e.what();
+  }
+  return result;
+}
+
+// statistical and API sanity checks of the CXKK generator; prints one line
+// per check and returns whether all of them passed
+bool CheckRandom() {
+  bool passed = true;
+  const auto report = [&passed](const std::string &name, bool ok) {
+    std::cout << (ok ? "PASS " : "FAIL ") << "random/" << name << '\n';
+    passed = passed && ok;
+  };
+
+  // chi-square of the byte histogram: 255 degrees of freedom, so a fair
+  // generator stays below 330 with probability 0.999
+  constexpr static std::size_t DRAWS = 1U << 20U;
+  constexpr static double CHI_SQUARE_LIMIT = 330;
+  RandomNumberGenerator random{1, 0};
+  std::array<std::size_t, Constants::MAX_BYTE + 1> histogram{};
+  for (std::size_t i = 0; i < DRAWS; ++i) {
+    ++histogram.at(random.Generate());
+  }
+  const double expected = static_cast<double>(DRAWS) / histogram.size();
+  double chiSquare = 0;
+  for (const auto count : histogram) {
+    const double delta = static_cast<double>(count) - expected;
+    chiSquare += delta * delta / expected;
+  }
+  report("chi-square=" + std::to_string(static_cast<int>(chiSquare)),
+         chiSquare < CHI_SQUARE_LIMIT);
+
+  // skipping ahead lands where drawing one at a time does
+  constexpr static std::uint64_t SKIP = 1000;
+  RandomNumberGenerator sequential{1, 1};
+  for (std::uint64_t i = 0; i < SKIP; ++i) {
+    sequential.Generate();
+  }
+  RandomNumberGenerator skipped{1, 1};
+  skipped.Seek(SKIP);
+  bool same = true;
+  for (std::uint64_t i = 0; i < SKIP; ++i) {
+    same = same && sequential.Generate() == skipped.Generate();
+  }
+  report("seek", same);
+
+  // a batch lane is the scalar draw of that lane's stream
+  constexpr static std::size_t LANES = 64;
+  std::vector<std::uint64_t> keys(LANES);
+  std::vector<std::uint64_t> counters(LANES);
+  std::vector<std::uint32_t> out(LANES);
+  for (std::size_t lane = 0; lane < LANES; ++lane) {
+    keys[lane] = RandomNumberGenerator{1, lane}.Key();
+    counters[lane] = lane * lane;
+  }
+  RandomNumberGenerator::GenerateBatch(keys, counters, out);
+  same = true;
+  for (std::size_t lane = 0; lane < LANES; ++lane) {
+    same = same && out[lane] == RandomNumberGenerator::Squares32(
+                                  counters[lane], keys[lane]);
+  }
+  report("batch", same);
+
+  // neighbouring instances and seeds draw different streams
+  RandomNumberGenerator first{1, 0};
+  RandomNumberGenerator nextInstance{1, 1};
+  RandomNumberGenerator nextSeed{2, 0};
+  std::size_t collisions = 0;
+  for (std::uint64_t i = 0; i < SKIP; ++i) {
+    const auto value = first.Generate();
+    collisions += static_cast<std::size_t>(value == nextInstance.Generate());
+    collisions += static_cast<std::size_t>(value == nextSeed.Generate());
+  }
+  // about 2 * SKIP / 256 for independent streams
+  constexpr static std::size_t MAX_COLLISIONS = 2 * SKIP / 64;
+  report("streams", collisions < MAX_COLLISIONS);
+
+  // a snapshot resumes the stream where it was taken
+  std::array<std::uint8_t, RandomNumberGenerator::STATE_BYTES> state{};
+  random.Save(state);
+  const auto next = random.Generate();
+  RandomNumberGenerator restored{0, 0};
+  restored.Load(state);
+  report("save-load", restored.Generate() == next &&
+                        restored.Key() == random.Key());
+  return passed;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::filesystem::path romDir = CHIP8_EXAMPLE_PROGRAMS_DIR;
+  std::filesystem::path golden;
+  double threshold = 0.5;
+  bool update = false;
+  bool failOnRegression = false;
+  bool skipLoops = true;
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    const auto &flag = args[i];
+    const bool hasValue = i + 1 < args.size();
+    if (flag == "--roms" && hasValue) {
+      romDir = args[++i];
+    } else if (flag == "--golden" && hasValue) {
+      golden = args[++i];
+    } else if (flag == "--threshold" && hasValue) {
+      threshold = std::stod(args[++i]);
+    } else if (flag == "--update") {
+      update = true;
+    } else if (flag == "--fail-on-regression") {
+      failOnRegression = true;
+    } else if (flag == "--no-skip-loops") {
+      skipLoops = false;
+    } else {
+      std::cerr << "usage: chip8_conformance [--roms DIR] [--golden FILE] "
+                   "[--threshold FRACTION] [--update] [--fail-on-regression] "
+                   "[--no-skip-loops]\n";
+      return 1;
+    }
+  }
+  if (golden.empty()) {
+    golden = romDir / "golden.txt";
+  }
+
+  auto entries = ReadGolden(golden);
+  std::vector<RunResult> results(entries.size());
+  // one ROM per worker, claimed from a shared counter
+  std::atomic<std::size_t> nextEntry = 0;
+  std::vector<std::thread> workers;
+  const auto numWorkers = std::clamp<std::size_t>(
+    std::thread::hardware_concurrency(), 1, entries.size());
+  for (std::size_t w = 0; w < numWorkers; ++w) {
+    workers.emplace_back([&]() {
+      for (auto i = nextEntry++; i < entries.size(); i = nextEntry++) {
+        results[i] = RunRom(romDir, entries[i], skipLoops);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  bool failed = !CheckRandom();
+  bool regressed = false;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    auto &entry = entries[i];
+    const auto &result = results[i];
+    if (!result.error.empty()) {
+      std::cout << "ERROR " << entry.rom << ": " << result.error << '\n';
+      failed = true;
+      continue;
+    }
+    const bool matches = result.hash == entry.hash;
+    const bool slow = entry.instructionsPerSecond > 0 &&
+                      result.instructionsPerSecond <
+                        entry.instructionsPerSecond * (1 - threshold);
+    std::cout << (matches || update ? "PASS " : "FAIL ") << entry.rom
+              << " hash=" << std::hex << result.hash << std::dec
+              << " ips="
+              << static_cast<std::uint64_t>(result.instructionsPerSecond)
+              << " baseline="
+              << static_cast<std::uint64_t>(entry.instructionsPerSecond)
+              << " frames_run=" << result.executed;
+    if (result.loopPeriod != 0) {
+      std::cout << " loop=" << result.loopPeriod << " effective_ips="
+                << static_cast<std::uint64_t>(
+                     result.effectiveInstructionsPerSecond);
+    }
+    std::cout << (slow ? " REGRESSION" : "") << '\n';
+    failed = failed || (!matches && !update);
+    regressed = regressed || slow;
+    if (update) {
+      entry.hash = result.hash;
+      entry.instructionsPerSecond = result.instructionsPerSecond;
+    }
+  }
+  if (update && !failed) {
+    WriteGolden(golden, entries);
+  }
+  return failed || (regressed && failOnRegression) ? 1 : 0;
+}
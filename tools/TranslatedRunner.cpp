@@ -0,0 +1,104 @@
+#include "Chip8Core.hpp"
+#include "StateHash.hpp"
+#include "Translated.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+// Runs a translated ROM and the interpreter side by side for the same number
+// of frames, checks that they end in the same state and reports the
+// throughput of each. Linked with the output of chip8_translate.
+
+extern const TranslatedProgram TRANSLATED_PROGRAM;
+
+namespace {
+
+struct RunResult {
+  std::uint64_t hash = 0;
+  Chip8::State state{};
+  double instructionsPerSecond = 0;
+};
+
+// FNV-1a with one step per pixel colour, row major, independent of how the
+// screen stores its planes
+std::uint64_t HashFramebuffer(const Screen &screen) {
+  StateHasher hasher;
+  for (std::size_t y = 0; y < screen.Height(); ++y) {
+    for (std::size_t x = 0; x < screen.Width(); ++x) {
+      hasher.Add(screen.ColorAt(x, y));
+    }
+  }
+  return hasher.Value();
+}
+
+RunResult Run(std::size_t frames,
+              const std::function<void(Chip8Core &)> &runFrames) {
+  const auto core = Chip8Core::Create();
+  core->Machine().SetTraceDumpStream(nullptr);
+  core->LoadProgram(TRANSLATED_PROGRAM.rom);
+  const auto start = std::chrono::steady_clock::now();
+  runFrames(*core);
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return {HashFramebuffer(core->Framebuffer()), core->GetState(),
+          static_cast<double>(frames * Chip8::INSTRUCTIONS_PER_FRAME) /
+            std::max(elapsed.count(), 1e-9)};
+}
+
+bool SameState(const Chip8::State &a, const Chip8::State &b) {
+  return a.registers == b.registers && a.programCounter == b.programCounter &&
+         a.index == b.index && a.stackDepth == b.stackDepth &&
+         a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t frames = 100000;
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (args[i] == "--frames" && i + 1 < args.size()) {
+      frames = std::stoul(args[++i]);
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--frames N]\n";
+      return 1;
+    }
+  }
+
+  try {
+    const auto interpreted = Run(frames, [&](Chip8Core &core) {
+      for (std::size_t frame = 0; frame < frames; ++frame) {
+        core.RunFrame();
+      }
+    });
+    bool fellBack = false;
+    const auto translated = Run(frames, [&](Chip8Core &core) {
+      TranslatedRunner runner{&core.Machine(), TRANSLATED_PROGRAM};
+      for (std::size_t frame = 0; frame < frames; ++frame) {
+        runner.RunFrame();
+      }
+      fellBack = !runner.UsingTranslation();
+    });
+
+    const bool matches = interpreted.hash == translated.hash &&
+                         SameState(interpreted.state, translated.state);
+    std::cout << (matches ? "PASS" : "FAIL") << " frames=" << frames
+              << " hash=" << std::hex << translated.hash << std::dec
+              << " interpreted_ips="
+              << static_cast<std::uint64_t>(interpreted.instructionsPerSecond)
+              << " translated_ips="
+              << static_cast<std::uint64_t>(translated.instructionsPerSecond)
+              << (fellBack ? " (self-modifying, fell back)" : "") << '\n';
+    return matches ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::cerr << "ERROR " << e.what() << '\n';
+    return 1;
+  }
+}
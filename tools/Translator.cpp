@@ -0,0 +1,337 @@
+#include "Translated.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// chip8_translate: compiles a CHIP-8 ROM into a C++ translation unit that
+// defines TRANSLATED_PROGRAM for TranslatedRunner.
+//
+// Control flow is recovered by recursive descent from the entry point over
+// 1NNN, 2NNN, 00EE and the skip instructions. Every reachable instruction is
+// placed in a basic block that ends at a control transfer; the block calls
+// Chip8::Native::Execute with the instruction as a constant. BNNN targets
+// are unknown ahead of time, so they end a block and the runner looks the
+// target up (or interprets) at run time. Instructions the interpreter would
+// reject are left untranslated so the interpreter raises the error.
+
+namespace {
+
+constexpr std::size_t PROGRAM_START = 0x200;
+constexpr std::size_t ADDRESS_SPACE = 4096;
+
+enum class Flow {
+  NEXT,
+  /** a plain instruction that writes memory (FX33, FX55) */
+  WRITE,
+  JUMP,
+  CALL,
+  RETURN,
+  SKIP,
+  INDIRECT,
+  WAIT,
+  INVALID,
+};
+
+// mirrors the decoding in Chip8::ExecuteInstruction
+// NOLINTNEXTLINE(*cognitive-complexity)
+Flow Classify(int instruction) {
+  // NOLINTBEGIN(*-magic-numbers)
+  const auto lastNibble = instruction & 0x000F;
+  const auto lastByte = instruction & 0x00FF;
+  switch (instruction & 0xF000) {
+  case 0x0000:
+    // SUPER-CHIP 00CN, 00FB, 00FC, 00FE, 00FF and XO-CHIP 00DN
+    if ((instruction & 0xFFF0) == 0x00C0 ||
+        (instruction & 0xFFF0) == 0x00D0 || instruction == 0x00FB ||
+        instruction == 0x00FC || instruction == 0x00FE ||
+        instruction == 0x00FF) {
+      return Flow::NEXT;
+    }
+    if (lastNibble == 0x0 || lastNibble == 0x4) {
+      return Flow::NEXT;
+    }
+    return lastNibble == 0xE ? Flow::RETURN : Flow::INVALID;
+  case 0x1000:
+    return Flow::JUMP;
+  case 0x2000:
+    return Flow::CALL;
+  case 0x5000:
+    // XO-CHIP 5XY2 stores a register range, 5XY3 loads one
+    if (lastNibble == 0x2) {
+      return Flow::WRITE;
+    }
+    return lastNibble == 0x3 ? Flow::NEXT : Flow::SKIP;
+  case 0x3000:
+  case 0x4000:
+  case 0x9000:
+    return Flow::SKIP;
+  case 0x6000:
+  case 0x7000:
+  case 0xA000:
+  case 0xC000:
+  case 0xD000:
+    return Flow::NEXT;
+  case 0x8000:
+    return lastNibble <= 0x7 || lastNibble == 0xE ? Flow::NEXT : Flow::INVALID;
+  case 0xB000:
+    return Flow::INDIRECT;
+  case 0xE000:
+    return lastNibble == 0xE || lastNibble == 0x1 ? Flow::SKIP : Flow::INVALID;
+  case 0xF000:
+    switch (lastByte) {
+    case 0x01:
+    case 0x07:
+    case 0x15:
+    case 0x18:
+    case 0x1E:
+    case 0x29:
+    case 0x30:
+    case 0x65:
+    case 0x75:
+    case 0x85:
+      return Flow::NEXT;
+    case 0x33:
+    case 0x55:
+      return Flow::WRITE;
+    case 0x0A:
+      return Flow::WAIT;
+    default:
+      // includes XO-CHIP F000 NNNN, which is two words long
+      return Flow::INVALID;
+    }
+  default:
+    return Flow::INVALID;
+  }
+  // NOLINTEND(*-magic-numbers)
+}
+
+bool EndsBlock(Flow flow) {
+  return flow != Flow::NEXT && flow != Flow::WRITE;
+}
+
+class Translator {
+public:
+  explicit Translator(std::vector<std::uint8_t> rom) : _rom(std::move(rom)) {}
+
+  void Analyze() {
+    std::vector<std::size_t> work{PROGRAM_START};
+    _leaders.insert(PROGRAM_START);
+    while (!work.empty()) {
+      const auto address = work.back();
+      work.pop_back();
+      if (!InRom(address) || _instructions.contains(address)) {
+        continue;
+      }
+      const auto instruction = InstructionAt(address);
+      const auto flow = Classify(instruction);
+      if (flow == Flow::INVALID) {
+        continue;
+      }
+      _instructions[address] = instruction;
+      const auto visit = [&](std::size_t target, bool leader) {
+        if (leader) {
+          _leaders.insert(target);
+        }
+        work.push_back(target);
+      };
+      // NOLINTNEXTLINE(*-magic-numbers)
+      const auto target = static_cast<std::size_t>(instruction & 0x0FFF);
+      switch (flow) {
+      case Flow::NEXT:
+      case Flow::WRITE:
+        visit(address + 2, false);
+        break;
+      case Flow::JUMP:
+        visit(target, true);
+        break;
+      case Flow::CALL:
+        visit(target, true);
+        visit(address + 2, true);
+        break;
+      case Flow::SKIP:
+        visit(address + 2, true);
+        // skipping an F000 NNNN skips both of its words
+        // NOLINTNEXTLINE(*-magic-numbers)
+        visit(InRom(address + 2) && InstructionAt(address + 2) == 0xF000
+                ? address + 6
+                : address + 4,
+              true);
+        break;
+      case Flow::WAIT:
+        visit(address + 2, true);
+        break;
+      case Flow::RETURN:
+      case Flow::INDIRECT:
+      case Flow::INVALID:
+        break;
+      }
+    }
+  }
+
+  void Emit(std::ostream &out, const std::string &romName) const {
+    out << "// Generated by chip8_translate from " << romName
+        << ". Do not edit.\n"
+        << "#include \"Translated.hpp\"\n"
+        << "#include <array>\n\n"
+        << "namespace {\n\n"
+        << "using Block = TranslatedProgram::Block;\n\n";
+    for (const auto leader : _leaders) {
+      if (_instructions.contains(leader)) {
+        EmitBlock(out, leader);
+      }
+    }
+    EmitTables(out);
+    out << "} // namespace\n\n"
+        << "extern const TranslatedProgram TRANSLATED_PROGRAM{\n"
+        << "  0x" << std::hex << TranslatedProgram::HashRom(_rom) << std::dec
+        << "ULL, ROM, BLOCKS, CODE_MAP};\n";
+  }
+
+  [[nodiscard]] std::size_t NumInstructions() const {
+    return _instructions.size();
+  }
+
+  [[nodiscard]] std::size_t NumBlocks() const {
+    std::size_t blocks = 0;
+    for (const auto leader : _leaders) {
+      blocks += _instructions.contains(leader) ? 1 : 0;
+    }
+    return blocks;
+  }
+
+private:
+  [[nodiscard]] bool InRom(std::size_t address) const {
+    return address >= PROGRAM_START &&
+           address + 1 < PROGRAM_START + _rom.size();
+  }
+
+  [[nodiscard]] int InstructionAt(std::size_t address) const {
+    const auto offset = address - PROGRAM_START;
+    return _rom.at(offset) << 8 | _rom.at(offset + 1);
+  }
+
+  static std::string Hex(std::size_t value, int width = 3) {
+    std::stringstream stream;
+    stream << "0x" << std::hex << std::uppercase << std::setw(width)
+           << std::setfill('0') << value;
+    return stream.str();
+  }
+
+  void EmitBlock(std::ostream &out, std::size_t leader) const {
+    out << "std::size_t Block" << Hex(leader).substr(2)
+        << "(Chip8::Native &m, [[maybe_unused]] std::size_t budget) {\n";
+    std::size_t count = 0;
+    auto address = leader;
+    while (true) {
+      const auto instruction = _instructions.at(address);
+      const auto flow = Classify(instruction);
+      const auto next = address + 2;
+      if (count > 0) {
+        out << "  if (budget == " << count << ") {\n"
+            << "    m.SetProgramCounter(" << Hex(address) << ");\n"
+            << "    return " << count << ";\n  }\n";
+      }
+      ++count;
+      if (EndsBlock(flow)) {
+        // control transfers read the program counter
+        out << "  m.SetProgramCounter(" << Hex(next) << ");\n"
+            << "  m.Execute(" << Hex(instruction, 4) << ");\n"
+            << "  return " << count << ";\n}\n\n";
+        return;
+      }
+      out << "  m.Execute(" << Hex(instruction, 4) << ");\n";
+      if (flow == Flow::WRITE) {
+        out << "  if (m.CodeModified()) {\n"
+            << "    m.SetProgramCounter(" << Hex(next) << ");\n"
+            << "    return " << count << ";\n  }\n";
+      }
+      if (!_instructions.contains(next) || _leaders.contains(next)) {
+        out << "  m.SetProgramCounter(" << Hex(next) << ");\n"
+            << "  return " << count << ";\n}\n\n";
+        return;
+      }
+      address = next;
+    }
+  }
+
+  void EmitTables(std::ostream &out) const {
+    out << "constexpr std::array<std::uint8_t, " << _rom.size()
+        << "> ROM{";
+    for (std::size_t i = 0; i < _rom.size(); ++i) {
+      constexpr static std::size_t PER_LINE = 12;
+      out << (i % PER_LINE == 0 ? "\n  " : " ") << Hex(_rom[i], 2) << ',';
+    }
+    out << "\n};\n\n";
+
+    out << "constexpr auto BLOCKS = [] {\n"
+        << "  std::array<Block, " << ADDRESS_SPACE << "> blocks{};\n";
+    for (const auto leader : _leaders) {
+      if (_instructions.contains(leader)) {
+        out << "  blocks[" << Hex(leader) << "] = &Block"
+            << Hex(leader).substr(2) << ";\n";
+      }
+    }
+    out << "  return blocks;\n}();\n\n";
+
+    out << "constexpr auto CODE_MAP = [] {\n"
+        << "  std::array<std::uint8_t, " << ADDRESS_SPACE << "> code{};\n"
+        << "  for (const auto address : {";
+    bool first = true;
+    for (const auto &[address, instruction] : _instructions) {
+      out << (first ? "" : ", ") << Hex(address);
+      first = false;
+    }
+    out << "}) {\n"
+        << "    code[address] = 1;\n"
+        << "    code[address + 1] = 1;\n"
+        << "  }\n"
+        << "  return code;\n}();\n\n";
+  }
+
+  std::vector<std::uint8_t> _rom;
+  std::map<std::size_t, int> _instructions;
+  std::set<std::size_t> _leaders;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.size() != 2) {
+    std::cerr << "usage: chip8_translate ROM OUTPUT.cpp\n";
+    return 1;
+  }
+  const std::filesystem::path romPath = args[0];
+  std::ifstream file(romPath, std::ios::binary);
+  if (!file) {
+    std::cerr << "Cannot open ROM: " << romPath << '\n';
+    return 1;
+  }
+  std::vector<std::uint8_t> rom{std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>()};
+  if (rom.size() > ADDRESS_SPACE - PROGRAM_START) {
+    std::cerr << "ROM too large: " << romPath << '\n';
+    return 1;
+  }
+  Translator translator{std::move(rom)};
+  translator.Analyze();
+  std::ofstream out(args[1]);
+  translator.Emit(out, romPath.filename().string());
+  if (!out) {
+    std::cerr << "Cannot write " << args[1] << '\n';
+    return 1;
+  }
+  std::cerr << romPath.filename().string() << ": "
+            << translator.NumInstructions() << " instructions in "
+            << translator.NumBlocks() << " blocks\n";
+  return 0;
+}
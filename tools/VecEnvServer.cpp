@@ -0,0 +1,159 @@
+#include "VecEnv.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+// chip8_vecenv serve ROM [options]: host environments for training clients
+// chip8_vecenv bench [--name NAME] [--steps N] [--shutdown]: step a running
+// server as a client and report steps/s
+
+namespace {
+
+constexpr auto DEFAULT_NAME = "/chip8-vecenv";
+
+void PrintUsage() {
+  std::cerr
+    << "usage: chip8_vecenv serve ROM [--name NAME] [--envs N] [--workers N]\n"
+       "         [--frames-per-step N] [--reward mem:ADDR|reg:X]\n"
+       "         [--done mem:ADDR=VALUE|reg:X=VALUE] [--max-frames N]\n"
+       "         [--seed N]\n"
+       "       chip8_vecenv bench [--name NAME] [--steps N] [--shutdown]\n";
+}
+
+int Serve(const std::vector<std::string> &args) {
+  if (args.empty()) {
+    PrintUsage();
+    return 1;
+  }
+  std::ifstream file(args[0], std::ios::binary);
+  if (!file) {
+    std::cerr << "Cannot open ROM: " << args[0] << '\n';
+    return 1;
+  }
+  const std::vector<std::uint8_t> program{std::istreambuf_iterator<char>(file),
+                                          std::istreambuf_iterator<char>()};
+  std::string name = DEFAULT_NAME;
+  VecEnvConfig config;
+  config.workers = std::max(1U, std::thread::hardware_concurrency());
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    const auto &flag = args[i];
+    if (i + 1 >= args.size()) {
+      PrintUsage();
+      return 1;
+    }
+    const auto &value = args[++i];
+    if (flag == "--name") {
+      name = value;
+    } else if (flag == "--envs") {
+      config.numEnvs = std::stoul(value);
+    } else if (flag == "--workers") {
+      config.workers = std::stoul(value);
+    } else if (flag == "--frames-per-step") {
+      config.framesPerStep = std::stoul(value);
+    } else if (flag == "--reward") {
+      config.reward = VecEnvProbe::Parse(value);
+    } else if (flag == "--done") {
+      const auto equals = value.find('=');
+      if (equals == std::string::npos) {
+        PrintUsage();
+        return 1;
+      }
+      config.done = VecEnvProbe::Parse(value.substr(0, equals));
+      config.doneValue = static_cast<std::uint8_t>(
+        std::stoul(value.substr(equals + 1), nullptr, 16));
+    } else if (flag == "--max-frames") {
+      config.maxEpisodeFrames = static_cast<std::uint32_t>(std::stoul(value));
+    } else if (flag == "--seed") {
+      config.seed = std::stoull(value);
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+  VecEnvServer server{name, program, config};
+  std::cerr << "Serving " << config.numEnvs << " environments on " << name
+            << '\n';
+  server.Serve();
+  return 0;
+}
+
+int Bench(const std::vector<std::string> &args) {
+  std::string name = DEFAULT_NAME;
+  std::size_t steps = 10000;
+  bool shutdown = false;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (args[i] == "--name" && i + 1 < args.size()) {
+      name = args[++i];
+    } else if (args[i] == "--steps" && i + 1 < args.size()) {
+      steps = std::stoul(args[++i]);
+    } else if (args[i] == "--shutdown") {
+      shutdown = true;
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+  VecEnvClient client{name};
+  const auto slots = client.Slots();
+  std::uint64_t lit = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t step = 0; step < steps; ++step) {
+    for (auto &slot : slots) {
+      slot.action = static_cast<std::uint16_t>(1U << (step % 16));
+    }
+    client.Step();
+  }
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  for (const auto &slot : slots) {
+    for (const auto &row : slot.observation) {
+      for (const auto word : row) {
+        lit += static_cast<std::uint64_t>(std::popcount(word));
+      }
+    }
+  }
+  const auto stepsPerSecond = static_cast<double>(steps) / elapsed.count();
+  std::cout << "envs=" << slots.size() << " steps=" << steps
+            << " steps_per_s=" << static_cast<std::uint64_t>(stepsPerSecond)
+            << " env_steps_per_s="
+            << static_cast<std::uint64_t>(stepsPerSecond *
+                                          static_cast<double>(slots.size()))
+            << " lit_pixels=" << lit << '\n';
+  if (shutdown) {
+    client.Shutdown();
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.empty()) {
+    PrintUsage();
+    return 1;
+  }
+  try {
+    const std::vector rest(args.begin() + 1, args.end());
+    if (args[0] == "serve") {
+      return Serve(rest);
+    }
+    if (args[0] == "bench") {
+      return Bench(rest);
+    }
+    PrintUsage();
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+}